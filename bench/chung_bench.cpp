@@ -0,0 +1,783 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/TargetParser/Host.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+
+#include "chung/ast_cache.hpp"
+#include "chung/ast_dump.hpp"
+#include "chung/codegen.hpp"
+#include "chung/file.hpp"
+#include "chung/fold.hpp"
+#include "chung/lexer.hpp"
+#include "chung/parser.hpp"
+#include "chung/stringify.hpp"
+
+#include "chung/utils/ansi.hpp"
+
+#include "chung/library/prelude.hpp"
+
+// chung-bench: front-end throughput on generated (or given) programs. Every stage is timed on its own:
+//     lex      SourceMap + Lexer::lex
+//     parse    Parser::parse over a copy of the tokens
+//     flatten  AST -> FlatAst
+//     cache    content hash + AstCache::load of the flat AST, what an unchanged source costs instead of lex to flatten
+//     dump     JSON dump of the tokens and the flat AST into /dev/null, through an OutputSink
+//     fold     fold_constants over the flat AST. Only runs when selected, so codegen can be timed with and without
+//     codegen  FlatAst -> IR into a fresh Context
+//     emit     IR -> object file, in memory so the disk stays out of it
+// Allocations only count operator new, LLVM's own malloc-backed allocators are invisible here
+// Built like the compiler itself, from everything in src/ except cli.cpp
+// Parser microbenchmark: chung-bench --shape defs --size 64K --iterations 200 --stages parse
+// Incremental lexing: chung-bench --verify relex --edits 1000 checks Lexer::relex against lexing from scratch
+// Parallel lexing: chung-bench --verify chunks checks chunked lexes against a serial one, and
+// chung-bench --stages lex --size 4M --lex-chunks 1 (then 2, 4, ...) times the split against lexing serially
+// Error recovery: chung-bench --shape errors --shape editing --size 1M --stages lex,parse
+
+static std::atomic<size_t> allocation_count{0};
+static std::atomic<size_t> allocation_bytes{0};
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+enum class Shape {DEFS, DEEP, STRINGS, COMMENTS, ERRORS, EDITING};
+
+static const char* shape_names[] = {"defs", "deep", "strings", "comments", "errors", "editing"};
+static const char* stage_names[] = {"lex", "parse", "flatten", "cache", "dump", "fold", "codegen", "emit"};
+
+struct BenchOptions {
+    std::vector<Shape> shapes;
+    std::string file_path;
+    size_t size = 2 << 20;
+    size_t depth = 64;
+    size_t iterations = 5;
+    std::array<bool, 8> stages{true, true, true, true, true, true, true, true};
+    unsigned int seed = 69420;
+    bool json = false;
+    std::string output_path;
+    // Check instead of measure: "relex" or "chunks"
+    std::string verify;
+    size_t edits = 200;
+    // Chunks the lex stage splits the source into, 0 to leave it to Lexer::lex
+    size_t lex_chunks = 0;
+};
+
+struct StageResult {
+    const char* name;
+    // Disabled stages still run when a later stage needs them, they just aren't measured
+    bool enabled = true;
+    bool skipped = true;
+    double best_seconds = 0;
+    double total_seconds = 0;
+    size_t allocations = 0;
+    size_t allocated_bytes = 0;
+    long peak_rss_kb = 0;
+};
+
+struct CorpusResult {
+    std::string shape;
+    size_t bytes = 0;
+    size_t tokens = 0;
+    size_t nodes = 0;
+    size_t lex_exceptions = 0;
+    size_t parse_exceptions = 0;
+    std::vector<StageResult> stages{{"lex"}, {"parse"}, {"flatten"}, {"cache"}, {"dump"}, {"fold"}, {"codegen"}, {"emit"}};
+};
+
+// Corpus generation
+// Valid shapes stick to what codegen handles today (int literals, '+' and calls to print) so every stage runs
+
+static void generate_sum(std::string& out, std::mt19937& rng, size_t terms) {
+    for (size_t i = 0; i < terms; i++) {
+        if (i) {
+            out += " + ";
+        }
+        out += std::to_string(rng() % 100000);
+    }
+}
+
+static void generate_def(std::string& out, std::mt19937& rng, size_t index) {
+    out += "def f" + std::to_string(index) + "(a: int64, b: int64) {\n";
+    for (size_t i = 0, statements = 1 + rng() % 4; i < statements; i++) {
+        bool declaration = rng() % 2;
+        out += declaration ? "    let x" + std::to_string(i) + " = " : "    print(";
+        generate_sum(out, rng, 1 + rng() % 6);
+        out += declaration ? ";\n" : ");\n";
+    }
+    out += "}\n\n";
+}
+
+static void generate_deep(std::string& out, std::mt19937& rng, size_t index, size_t depth) {
+    out += "def deep" + std::to_string(index) + "() {\n    print(";
+    for (size_t i = 0; i < depth; i++) {
+        out += std::to_string(rng() % 1000) + " + (";
+    }
+    out += std::to_string(rng() % 1000);
+    out.append(depth, ')');
+    out += ");\n}\n\n";
+}
+
+static void generate_string(std::string& out, std::mt19937& rng, size_t index) {
+    static const char* words[] = {"chungus", "amogus", "sus", "bruh", "goofy", "ahh", "\\n", "\\t", "\\\"quoted\\\""};
+
+    out += "def s" + std::to_string(index) + "() {\n    let s = \"";
+    for (size_t i = 0, length = 64 + rng() % 1024; i < length; i++) {
+        out += words[rng() % std::size(words)];
+        out += ' ';
+    }
+    out += "\";\n}\n\n";
+}
+
+static void generate_comments(std::string& out, std::mt19937& rng, size_t index) {
+    for (size_t i = 0, lines = 4 + rng() % 12; i < lines; i++) {
+        out += "// ";
+        out.append(16 + rng() % 96, 'a' + rng() % 26);
+        out += '\n';
+    }
+    generate_def(out, rng, index);
+}
+
+static void generate_errors(std::string& out, std::mt19937& rng, size_t index) {
+    static const char* broken[] = {
+        "let = 5;\n",
+        "print(1 + );\n",
+        "let x = $;\n",
+        "def broken(a int64) { print(1); }\n",
+        "let y = (1 + 2;\n",
+        "print(1, 2 3);\n",
+        "let z = 99999999999999999999;\n",
+        "}\n",
+    };
+
+    // Roughly every other statement is broken
+    if (rng() % 2) {
+        generate_def(out, rng, index);
+    } else {
+        out += broken[rng() % std::size(broken)];
+    }
+}
+
+// Code in the middle of being edited: functions whose bodies are littered with half-typed statements
+static void generate_editing(std::string& out, std::mt19937& rng, size_t index) {
+    static const char* half_typed[] = {
+        "    let x = \n",
+        "    print(1, \n",
+        "    let = 3;\n",
+        "    print(a +);\n",
+        "    let y = (a + b;\n",
+        "    a + * b;\n",
+        "    let z = 1 2;\n",
+    };
+
+    out += "def e" + std::to_string(index) + "(a: int64, b: int64) {\n";
+    for (size_t i = 0, statements = 2 + rng() % 6; i < statements; i++) {
+        if (rng() % 2) {
+            out += half_typed[rng() % std::size(half_typed)];
+        } else {
+            out += "    print(";
+            generate_sum(out, rng, 1 + rng() % 6);
+            out += ");\n";
+        }
+    }
+    out += "}\n\n";
+}
+
+static std::string generate_corpus(Shape shape, const BenchOptions& options) {
+    std::mt19937 rng{options.seed};
+    std::string source;
+    source.reserve(options.size + 4096);
+
+    for (size_t index = 0; source.size() < options.size; index++) {
+        switch (shape) {
+            case Shape::DEFS: generate_def(source, rng, index); break;
+            case Shape::DEEP: generate_deep(source, rng, index, options.depth); break;
+            case Shape::STRINGS: generate_string(source, rng, index); break;
+            case Shape::COMMENTS: generate_comments(source, rng, index); break;
+            case Shape::ERRORS: generate_errors(source, rng, index); break;
+            case Shape::EDITING: generate_editing(source, rng, index); break;
+        }
+    }
+
+    return source;
+}
+
+// Measurement
+
+static long peak_rss_kb() {
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Times one run of a stage and folds it into the stage result
+template <typename F>
+static auto measure(StageResult& stage, F&& function) {
+    if (!stage.enabled) {
+        return function();
+    }
+
+    size_t allocations_before = allocation_count.load();
+    size_t bytes_before = allocation_bytes.load();
+    auto start = std::chrono::steady_clock::now();
+
+    auto result = function();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stage.best_seconds = stage.skipped ? seconds : std::min(stage.best_seconds, seconds);
+    stage.total_seconds += seconds;
+    stage.skipped = false;
+
+    // Every iteration does the same work, so the last one is as good as any
+    stage.allocations = allocation_count.load() - allocations_before;
+    stage.allocated_bytes = allocation_bytes.load() - bytes_before;
+    stage.peak_rss_kb = peak_rss_kb();
+
+    return result;
+}
+
+static CorpusResult run_corpus(const std::string& shape, std::string_view source, llvm::TargetMachine* target_machine, const BenchOptions& options) {
+    CorpusResult result;
+    result.shape = shape;
+    result.bytes = source.size();
+    for (size_t i = 0; i < result.stages.size(); i++) {
+        result.stages[i].enabled = options.stages[i];
+    }
+
+    for (size_t iteration = 0; iteration < options.iterations; iteration++) {
+        StageResult& lex_stage = result.stages[0];
+        StageResult& parse_stage = result.stages[1];
+        StageResult& flatten_stage = result.stages[2];
+        StageResult& cache_stage = result.stages[3];
+        StageResult& dump_stage = result.stages[4];
+        StageResult& fold_stage = result.stages[5];
+        StageResult& codegen_stage = result.stages[6];
+        StageResult& emit_stage = result.stages[7];
+
+        auto [source_map, lexed] = measure(lex_stage, [&] {
+            auto source_map = std::make_unique<SourceMap>(source);
+            Lexer lexer{*source_map};
+            return std::make_pair(std::move(source_map), options.lex_chunks ? lexer.lex_chunked(options.lex_chunks) : lexer.lex());
+        });
+        auto& [tokens, lex_exceptions] = lexed;
+
+        Context ctx{};
+        AstArena arena;
+        TokenStream parser_tokens = tokens.clone();
+
+        auto [statements, parse_exceptions] = measure(parse_stage, [&] {
+            Parser parser{std::move(parser_tokens), *source_map, ctx, arena};
+            auto statements = parser.parse();
+            return std::make_pair(std::move(statements), parser.get_exceptions().size());
+        });
+
+        result.tokens = tokens.size();
+        result.lex_exceptions = lex_exceptions.size();
+        result.parse_exceptions = parse_exceptions;
+
+        FlatAst flat = measure(flatten_stage, [&] {
+            return flatten(statements);
+        });
+        result.nodes = flat.size();
+
+        // Only programs without errors are cached
+        if (cache_stage.enabled && lex_exceptions.empty() && parse_exceptions == 0) {
+            AstCache cache{(std::filesystem::temp_directory_path() / "chung-bench-ast").string()};
+            cache.store(content_hash(source), flat);
+
+            measure(cache_stage, [&] {
+                FlatAst cached;
+                cache.load(content_hash(source), cached);
+                return cached.size();
+            });
+            std::filesystem::remove(cache.entry_path(content_hash(source)));
+        }
+
+        if (dump_stage.enabled) {
+            std::FILE* null_file = std::fopen("/dev/null", "wb");
+            if (null_file) {
+                measure(dump_stage, [&] {
+                    OutputSink sink{null_file};
+                    AstDumper dumper{sink, DumpFormat::JSON};
+                    dumper.dump_tokens(tokens);
+                    dumper.dump_ast(flat);
+                    dumper.finish();
+                    return 0;
+                });
+                std::fclose(null_file);
+            }
+        }
+
+        // Codegen of broken programs isn't worth measuring
+        if (!lex_exceptions.empty() || parse_exceptions != 0 || (!codegen_stage.enabled && !emit_stage.enabled && !fold_stage.enabled)) {
+            continue;
+        }
+
+        if (fold_stage.enabled) {
+            measure(fold_stage, [&] {
+                fold_constants(flat);
+                return 0;
+            });
+        }
+
+        setup_prelude(ctx);
+        measure(codegen_stage, [&] {
+            codegen(flat, ctx);
+            return 0;
+        });
+
+        if (!target_machine || !emit_stage.enabled) {
+            continue;
+        }
+
+        ctx.module->setDataLayout(target_machine->createDataLayout());
+        ctx.module->setTargetTriple(target_machine->getTargetTriple().str());
+
+        measure(emit_stage, [&] {
+            llvm::SmallVector<char, 0> object;
+            llvm::raw_svector_ostream dest{object};
+            llvm::legacy::PassManager pass;
+
+            if (target_machine->addPassesToEmitFile(pass, dest, nullptr, llvm::CGFT_ObjectFile)) {
+                return size_t{0};
+            }
+            pass.run(*ctx.module);
+            return object.size();
+        });
+    }
+
+    return result;
+}
+
+// Reporting
+
+static std::string json_escape(const std::string& string) {
+    std::string escaped;
+    for (char c: string) {
+        switch (c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            default: escaped += c; break;
+        }
+    }
+    return escaped;
+}
+
+static void write_json(std::ostream& out, const std::vector<CorpusResult>& results, const BenchOptions& options) {
+    out << std::setprecision(9);
+    out << "{\n";
+    out << "  \"iterations\": " << options.iterations << ",\n";
+    out << "  \"seed\": " << options.seed << ",\n";
+    out << "  \"corpora\": [\n";
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const CorpusResult& result = results[i];
+        out << "    {\n";
+        out << "      \"shape\": \"" << json_escape(result.shape) << "\",\n";
+        out << "      \"bytes\": " << result.bytes << ",\n";
+        out << "      \"tokens\": " << result.tokens << ",\n";
+        out << "      \"nodes\": " << result.nodes << ",\n";
+        out << "      \"lex_exceptions\": " << result.lex_exceptions << ",\n";
+        out << "      \"parse_exceptions\": " << result.parse_exceptions << ",\n";
+        out << "      \"stages\": {\n";
+
+        for (size_t j = 0; j < result.stages.size(); j++) {
+            const StageResult& stage = result.stages[j];
+            out << "        \"" << stage.name << "\": ";
+            if (stage.skipped) {
+                out << "null";
+            } else {
+                out << "{\"best_seconds\": " << stage.best_seconds
+                    << ", \"mean_seconds\": " << stage.total_seconds / options.iterations
+                    << ", \"mb_per_s\": " << result.bytes / 1e6 / stage.best_seconds
+                    << ", \"tokens_per_s\": " << result.tokens / stage.best_seconds
+                    << ", \"nodes_per_s\": " << result.nodes / stage.best_seconds
+                    << ", \"allocations\": " << stage.allocations
+                    << ", \"allocations_per_token\": " << (result.tokens ? static_cast<double>(stage.allocations) / result.tokens : 0)
+                    << ", \"allocated_bytes\": " << stage.allocated_bytes
+                    << ", \"peak_rss_kb\": " << stage.peak_rss_kb << '}';
+            }
+            out << (j + 1 < result.stages.size() ? ",\n" : "\n");
+        }
+
+        out << "      }\n";
+        out << "    }" << (i + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    out << "  ]\n";
+    out << "}\n";
+}
+
+static void write_table(std::ostream& out, const std::vector<CorpusResult>& results) {
+    out << std::fixed << std::setprecision(2);
+
+    for (auto& result: results) {
+        out << ANSI_BOLD << result.shape << ANSI_RESET << ": " << result.bytes << " bytes, " << result.tokens << " tokens, "
+            << result.nodes << " nodes, " << result.lex_exceptions << " lex / " << result.parse_exceptions << " parse exceptions\n";
+        out << "    " << std::left << std::setw(9) << "stage" << std::right
+            << std::setw(11) << "best ms" << std::setw(11) << "MB/s" << std::setw(13) << "Mtokens/s"
+            << std::setw(12) << "Mnodes/s" << std::setw(12) << "allocs" << std::setw(14) << "allocs/token" << std::setw(14) << "peak RSS MB" << '\n';
+
+        for (auto& stage: result.stages) {
+            out << "    " << std::left << std::setw(9) << stage.name << std::right;
+            if (stage.skipped) {
+                out << std::setw(11) << "skipped" << '\n';
+                continue;
+            }
+            out << std::setw(11) << stage.best_seconds * 1e3
+                << std::setw(11) << result.bytes / 1e6 / stage.best_seconds
+                << std::setw(13) << result.tokens / 1e6 / stage.best_seconds
+                << std::setw(12) << result.nodes / 1e6 / stage.best_seconds
+                << std::setw(12) << stage.allocations
+                << std::setprecision(4) << std::setw(14) << (result.tokens ? static_cast<double>(stage.allocations) / result.tokens : 0) << std::setprecision(2)
+                << std::setw(14) << stage.peak_rss_kb / 1024.0 << '\n';
+        }
+        out << '\n';
+    }
+}
+
+// Verification
+
+static bool same_token(const Token& token, const Token& expected) {
+    return token.type == expected.type && token.beg == expected.beg && token.end == expected.end && token.value.uint64 == expected.value.uint64;
+}
+
+// Where two lexes of the same source disagree, empty if they don't
+static std::string compare_lexes(const TokenStream& tokens, const std::vector<LexException>& exceptions,
+                                 const TokenStream& expected, const std::vector<LexException>& expected_exceptions) {
+    for (size_t i = 0; i < std::min(tokens.size(), expected.size()); i++) {
+        if (!same_token(tokens[i], expected[i])) {
+            return "token " + std::to_string(i) + " is " + std::string{token_name(tokens[i])} + " at " + std::to_string(tokens[i].beg) +
+                ", expected " + std::string{token_name(expected[i])} + " at " + std::to_string(expected[i].beg);
+        }
+    }
+    if (tokens.size() != expected.size()) {
+        return std::to_string(tokens.size()) + " tokens, expected " + std::to_string(expected.size());
+    }
+
+    if (exceptions.size() != expected_exceptions.size()) {
+        return std::to_string(exceptions.size()) + " exceptions, expected " + std::to_string(expected_exceptions.size());
+    }
+    for (size_t i = 0; i < exceptions.size(); i++) {
+        const LexException& exception = exceptions[i];
+        const LexException& expected_exception = expected_exceptions[i];
+        if (exception.start != expected_exception.start || exception.end != expected_exception.end ||
+            exception.exception_message != expected_exception.exception_message) {
+            return "exception " + std::to_string(i) + " is \"" + exception.exception_message + "\" at " + std::to_string(exception.start) +
+                ", expected \"" + expected_exception.exception_message + "\" at " + std::to_string(expected_exception.start);
+        }
+    }
+    return {};
+}
+
+// Applies random edits one after the other, each relexed from the tokens of the one before, and compares every
+// result with lexing the edited source from scratch. The edits favor what upsets a lexer: quotes, comments,
+// newlines and half numbers, cut in anywhere
+static bool verify_relex(const std::string& name, std::string_view corpus, const BenchOptions& options) {
+    static const char* fragments[] = {
+        " ", "\n", "\t", "\"", "\\", "/", "//", "// note\n", "x", "let ", "def ", "123", "4.5", "7u", "0.", "99999999999999999999",
+        "(", ")", "{", "}", ";", ",", "+", "**", "=", "$", "\"text\"", "\"open",
+    };
+
+    std::mt19937 rng{options.seed};
+
+    // Tokens point into their source, so every version stays where it is until the next one replaced it
+    auto source = std::make_unique<std::string>(corpus);
+    auto source_map = std::make_unique<SourceMap>(*source);
+    TokenStream tokens;
+    std::vector<LexException> exceptions;
+    std::tie(tokens, exceptions) = Lexer{*source_map}.lex();
+
+    for (size_t i = 0; i < options.edits; i++) {
+        size_t offset = rng() % (source->size() + 1);
+        size_t removed_length = std::min<size_t>(rng() % 17, source->size() - offset);
+        std::string inserted_text;
+        for (size_t j = 0, count = rng() % 4; j < count; j++) {
+            inserted_text += fragments[rng() % std::size(fragments)];
+        }
+
+        auto edited = std::make_unique<std::string>(source->substr(0, offset) + inserted_text + source->substr(offset + removed_length));
+        auto edited_map = std::make_unique<SourceMap>(*edited);
+        SourceEdit edit{static_cast<uint32_t>(offset), static_cast<uint32_t>(removed_length), inserted_text};
+
+        TokenStream relexed;
+        std::vector<LexException> relexed_exceptions;
+        std::tie(relexed, relexed_exceptions) = Lexer{*edited_map}.relex(std::move(tokens), exceptions, edit);
+
+        TokenStream expected;
+        std::vector<LexException> expected_exceptions;
+        std::tie(expected, expected_exceptions) = Lexer{*edited_map}.lex();
+
+        std::string mismatch = compare_lexes(relexed, relexed_exceptions, expected, expected_exceptions);
+        if (!mismatch.empty()) {
+            std::cerr << ANSI_RED << name << ": edit " << i << " (" << removed_length << " bytes at " << offset << " replaced by \""
+                << inserted_text << "\"): " << mismatch << '\n' << ANSI_RESET;
+            return false;
+        }
+
+        tokens = std::move(relexed);
+        exceptions = std::move(relexed_exceptions);
+        source_map = std::move(edited_map);
+        source = std::move(edited);
+    }
+
+    std::cout << name << ": " << options.edits << " edits relexed, all equal to lexing from scratch\n";
+    return true;
+}
+
+// Lexes the source in every chunk count up to 64 and compares each with lexing it serially. Identifier symbols
+// are compared too, so chunks have to merge their private interners back correctly
+static bool verify_chunks(const std::string& name, std::string_view source) {
+    SourceMap source_map{source};
+    TokenStream expected;
+    std::vector<LexException> expected_exceptions;
+    std::tie(expected, expected_exceptions) = Lexer{source_map}.lex_chunked(1);
+
+    for (size_t chunk_count = 2; chunk_count <= 64; chunk_count++) {
+        TokenStream tokens;
+        std::vector<LexException> exceptions;
+        std::tie(tokens, exceptions) = Lexer{source_map}.lex_chunked(chunk_count);
+
+        std::string mismatch = compare_lexes(tokens, exceptions, expected, expected_exceptions);
+        if (!mismatch.empty()) {
+            std::cerr << ANSI_RED << name << ": " << chunk_count << " chunks: " << mismatch << '\n' << ANSI_RESET;
+            return false;
+        }
+    }
+
+    std::cout << name << ": lexed in 2 to 64 chunks, all equal to lexing serially\n";
+    return true;
+}
+
+// CLI
+
+static void run_help() {
+    std::cout << "Chungussy front-end benchmark\n\n";
+    std::cout << "Usage:\n";
+    std::cout << "    chung-bench [options]\n\n";
+    std::cout << "Options:\n";
+    std::cout << "    --shape <name>       Corpus to generate: defs, deep, strings, comments, errors, editing or all (default), repeatable\n";
+    std::cout << "    --file <file.chung>  Benchmark an existing file instead of a generated corpus\n";
+    std::cout << "    --size <bytes>       Approximate size of each generated corpus (default 2 MiB), accepts K and M suffixes\n";
+    std::cout << "    --depth <n>          Nesting depth of the deep expressions (default 64)\n";
+    std::cout << "    --iterations <n>     Runs per corpus, the best one is reported (default 5)\n";
+    std::cout << "    --stages <list>      Comma-separated stages to measure (default lex,parse,flatten,cache,dump,fold,codegen,emit)\n";
+    std::cout << "    --seed <n>           Seed of the corpus generator\n";
+    std::cout << "    --json               Write the results as JSON\n";
+    std::cout << "    --output <file>      Write the results to a file instead of stdout\n";
+    std::cout << "    --verify <check>     Check the lexer instead of measuring, exits with 1 on a difference:\n";
+    std::cout << "                             relex   random edits relexed incrementally vs. lexed from scratch\n";
+    std::cout << "                             chunks  lexing in 2 to 64 parallel chunks vs. lexing serially\n";
+    std::cout << "    --edits <n>          Edits per corpus for --verify relex (default 200)\n";
+    std::cout << "    --lex-chunks <n>     Lex in n parallel chunks whatever the size, 1 for serially (default: as chung does)\n";
+}
+
+static size_t parse_size(const std::string& string) {
+    size_t multiplier = 1;
+    switch (string.empty() ? '\0' : string.back()) {
+        case 'K': case 'k': multiplier = 1 << 10; break;
+        case 'M': case 'm': multiplier = 1 << 20; break;
+    }
+    return std::stoull(string) * multiplier;
+}
+
+static BenchOptions parse_options(const std::vector<std::string>& args) {
+    BenchOptions options;
+
+    for (size_t i = 0; i < args.size(); i++) {
+        const std::string& arg = args[i];
+        if (arg == "--help" || arg == "help") {
+            run_help();
+            std::exit(0);
+        } else if (arg == "--json") {
+            options.json = true;
+            continue;
+        }
+
+        if (i + 1 == args.size()) {
+            std::cerr << ANSI_RED << "Expected a value after " << arg << '\n' << ANSI_RESET;
+            std::exit(1);
+        }
+        const std::string& value = args[++i];
+
+        try {
+            if (arg == "--shape") {
+                if (value == "all") {
+                    options.shapes.insert(options.shapes.end(), {Shape::DEFS, Shape::DEEP, Shape::STRINGS, Shape::COMMENTS, Shape::ERRORS, Shape::EDITING});
+                    continue;
+                }
+                auto shape = std::find(std::begin(shape_names), std::end(shape_names), value);
+                if (shape == std::end(shape_names)) {
+                    std::cerr << ANSI_RED << "Unknown shape \"" << value << "\"\n" << ANSI_RESET;
+                    std::exit(1);
+                }
+                options.shapes.push_back(static_cast<Shape>(shape - std::begin(shape_names)));
+            } else if (arg == "--file") {
+                options.file_path = value;
+            } else if (arg == "--size") {
+                options.size = parse_size(value);
+            } else if (arg == "--depth") {
+                options.depth = std::stoull(value);
+            } else if (arg == "--iterations") {
+                options.iterations = std::max<size_t>(1, std::stoull(value));
+            } else if (arg == "--stages") {
+                options.stages.fill(false);
+
+                std::stringstream stages{value};
+                std::string stage;
+                while (std::getline(stages, stage, ',')) {
+                    auto name = std::find(std::begin(stage_names), std::end(stage_names), stage);
+                    if (name == std::end(stage_names)) {
+                        std::cerr << ANSI_RED << "Unknown stage \"" << stage << "\"\n" << ANSI_RESET;
+                        std::exit(1);
+                    }
+                    options.stages[name - std::begin(stage_names)] = true;
+                }
+            } else if (arg == "--seed") {
+                options.seed = std::stoul(value);
+            } else if (arg == "--output") {
+                options.output_path = value;
+            } else if (arg == "--verify") {
+                if (value != "relex" && value != "chunks") {
+                    std::cerr << ANSI_RED << "Unknown check \"" << value << "\"\n" << ANSI_RESET;
+                    std::exit(1);
+                }
+                options.verify = value;
+            } else if (arg == "--edits") {
+                options.edits = std::stoull(value);
+            } else if (arg == "--lex-chunks") {
+                options.lex_chunks = std::stoull(value);
+            } else {
+                std::cerr << ANSI_RED << "Unknown option " << arg << '\n' << ANSI_RESET;
+                std::exit(1);
+            }
+        } catch (std::logic_error&) {
+            std::cerr << ANSI_RED << "Invalid value \"" << value << "\" for " << arg << '\n' << ANSI_RESET;
+            std::exit(1);
+        }
+    }
+
+    if (options.shapes.empty() && options.file_path.empty()) {
+        options.shapes = {Shape::DEFS, Shape::DEEP, Shape::STRINGS, Shape::COMMENTS, Shape::ERRORS, Shape::EDITING};
+    }
+
+    return options;
+}
+
+static std::unique_ptr<llvm::TargetMachine> create_target_machine() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    std::string target_triple = llvm::sys::getDefaultTargetTriple();
+    std::string target_error;
+
+    auto target = llvm::TargetRegistry::lookupTarget(target_triple, target_error);
+    if (!target) {
+        std::cerr << ANSI_RED << "No target, emission won't be measured: " << target_error << '\n' << ANSI_RESET;
+        return nullptr;
+    }
+
+    llvm::TargetOptions target_options;
+    auto rm = std::optional<llvm::Reloc::Model>();
+    return std::unique_ptr<llvm::TargetMachine>{target->createTargetMachine(target_triple, "generic", "", target_options, rm)};
+}
+
+static int run_verify(const BenchOptions& options) {
+    auto verify = [&](const std::string& name, std::string_view source) {
+        return options.verify == "relex" ? verify_relex(name, source, options) : verify_chunks(name, source);
+    };
+    bool passed = true;
+
+    if (!options.file_path.empty()) {
+        SourceFile source_file{options.file_path};
+        passed &= verify(options.file_path, source_file.get_source());
+    }
+
+    for (Shape shape: options.shapes) {
+        std::string source = generate_corpus(shape, options);
+        passed &= verify(shape_names[static_cast<size_t>(shape)], source);
+    }
+
+    return passed ? 0 : 1;
+}
+
+int main(const int argc, const char** argv) {
+    BenchOptions options = parse_options(std::vector<std::string>{argv + 1, argv + argc});
+    if (!options.file_path.empty() && options.file_path != "-" && !file_exists(options.file_path)) {
+        std::cerr << ANSI_RED << "File not found: \"" << options.file_path << "\" cannot be located" << '\n' << ANSI_RESET;
+        std::exit(1);
+    }
+
+    if (!options.verify.empty()) {
+        return run_verify(options);
+    }
+
+    std::unique_ptr<llvm::TargetMachine> target_machine = create_target_machine();
+
+    std::vector<CorpusResult> results;
+
+    if (!options.file_path.empty()) {
+        SourceFile source_file{options.file_path};
+        results.push_back(run_corpus(options.file_path, source_file.get_source(), target_machine.get(), options));
+    }
+
+    for (Shape shape: options.shapes) {
+        std::string source = generate_corpus(shape, options);
+        results.push_back(run_corpus(shape_names[static_cast<size_t>(shape)], source, target_machine.get(), options));
+    }
+
+    std::ofstream output_file;
+    if (!options.output_path.empty()) {
+        output_file.open(options.output_path);
+        if (!output_file) {
+            std::cerr << ANSI_RED << "Could not open file: " << options.output_path << '\n' << ANSI_RESET;
+            std::exit(1);
+        }
+    }
+    std::ostream& out = options.output_path.empty() ? std::cout : output_file;
+
+    if (options.json) {
+        write_json(out, results, options);
+    } else {
+        write_table(out, results);
+    }
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// View of an array, usually one living in an AstArena
+template <typename T>
+class ArenaSpan {
+public:
+    ArenaSpan(): data_{nullptr}, size_{0} {}
+    ArenaSpan(T* data, size_t size): data_{data}, size_{static_cast<uint32_t>(size)} {}
+
+    inline T* begin() const { return data_; }
+    inline T* end() const { return data_ + size_; }
+    inline T* data() const { return data_; }
+    inline size_t size() const { return size_; }
+    inline bool empty() const { return size_ == 0; }
+
+    inline T& operator[](size_t idx) const {
+        return data_[idx];
+    }
+
+private:
+    T* data_;
+    uint32_t size_;
+};
+
+// Bump allocator owning every AST node of a compilation unit. Nodes are carved out of big blocks and are never
+// destroyed one by one: the whole tree goes away with the arena, so nodes must not own any heap memory themselves
+class AstArena {
+public:
+    AstArena(size_t block_size = 64 << 10);
+
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+
+    inline void* allocate(size_t size, size_t alignment) {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(cursor) + alignment - 1) & ~(alignment - 1);
+        if (aligned + size > reinterpret_cast<uintptr_t>(limit)) {
+            return allocate_slow(size, alignment);
+        }
+
+        cursor = reinterpret_cast<char*>(aligned + size);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    template <typename T, typename... Args>
+    inline T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena nodes are never destroyed");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Copies [first, last) into the arena, e.g. the parser's scratch stack of children
+    template <typename T, typename Iterator>
+    inline ArenaSpan<T> copy(Iterator first, Iterator last) {
+        static_assert(std::is_trivially_copyable_v<T>, "Arena arrays are copied bytewise");
+
+        size_t size = last - first;
+        if (size == 0) {
+            return {};
+        }
+
+        T* data = static_cast<T*>(allocate(sizeof(T) * size, alignof(T)));
+        for (size_t i = 0; first != last; ++first, ++i) {
+            data[i] = static_cast<T>(*first);
+        }
+        return {data, size};
+    }
+
+    inline std::string_view copy_string(std::string_view string) {
+        if (string.empty()) {
+            return {};
+        }
+
+        char* data = static_cast<char*>(allocate(string.size(), 1));
+        std::memcpy(data, string.data(), string.size());
+        return {data, string.size()};
+    }
+
+    // Takes over every block of the other arena, e.g. one a parser worker filled. Nodes keep their addresses, and
+    // the other arena is left empty
+    void adopt(AstArena&& other);
+
+    inline size_t bytes_allocated() const {
+        return total_bytes - (limit - cursor);
+    }
+
+private:
+    void* allocate_slow(size_t size, size_t alignment);
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* cursor;
+    char* limit;
+
+    size_t block_size;
+    size_t total_bytes;
+};
@@ -1,106 +1,130 @@
 #pragma once
 
-#include <memory>
-#include <vector>
+#include <string>
+#include <string_view>
 
+#include "chung/arena.hpp"
 #include "chung/context.hpp"
+#include "chung/flat_ast.hpp"
+#include "chung/interner.hpp"
 #include "chung/token.hpp"
 #include "chung/type.hpp"
 
+// Nodes live in an AstArena and are never destroyed individually: names are Symbols of the global Interner, strings
+// are views into the arena, children are plain pointers and child lists are ArenaSpans
 class AST {
 public:
-    virtual ~AST() = default;
     virtual std::string stringify(size_t indent_level = 0) = 0;
     virtual llvm::Value* codegen(Context& ctx) = 0;
+    virtual NodeIndex flatten(FlatAst& flat) = 0;
 };
 
 class StmtAST: public AST {
 public:
-    virtual ~StmtAST() = default;
     virtual std::string stringify(size_t indent_level = 0) = 0;
     virtual llvm::Value* codegen(Context& ctx) = 0;
+    virtual NodeIndex flatten(FlatAst& flat) = 0;
 };
 
 class ExprAST: public AST {
 public:
-    virtual ~ExprAST() = default;
     virtual std::string stringify(size_t indent_level = 0) = 0;
     virtual llvm::Value* codegen(Context& ctx) = 0;
+    virtual NodeIndex flatten(FlatAst& flat) = 0;
 };
 
 class VarDeclareAST: public StmtAST {
 public:
-    std::string name;
+    Symbol name;
     Type& type;
-    std::shared_ptr<ExprAST> expr;
+    ExprAST* expr;
 
-    VarDeclareAST(const std::string& name, Type& type, std::shared_ptr<ExprAST> expr):
-        name{name}, type{type}, expr{std::move(expr)} {}
+    VarDeclareAST(Symbol name, Type& type, ExprAST* expr):
+        name{name}, type{type}, expr{expr} {}
 
     std::string stringify(size_t indent_level = 0);
     virtual llvm::Value* codegen(Context& ctx);
+    virtual NodeIndex flatten(FlatAst& flat);
 };
 
 class FunctionAST: public StmtAST {
 public:
-    std::string name;
-    std::vector<VarDeclareAST> parameters;
-    std::vector<std::shared_ptr<StmtAST>> body;
+    Symbol name;
+    ArenaSpan<VarDeclareAST*> parameters;
+    ArenaSpan<StmtAST*> body;
 
     // FOR NOW; I just want things to work
-    std::shared_ptr<ExprAST> return_type;
+    ExprAST* return_type = nullptr;
 
-    FunctionAST(const std::string& name, std::vector<VarDeclareAST> parameters, std::vector<std::shared_ptr<StmtAST>> body):
-        name{name}, parameters{std::move(parameters)}, body{std::move(body)} {}
+    FunctionAST(Symbol name, ArenaSpan<VarDeclareAST*> parameters, ArenaSpan<StmtAST*> body):
+        name{name}, parameters{parameters}, body{body} {}
 
 
     std::string stringify(size_t indent_level = 0);
     virtual llvm::Value* codegen(Context& ctx);
+    virtual NodeIndex flatten(FlatAst& flat);
 };
 
 class OmgAST: public StmtAST {
 public:
-    std::shared_ptr<ExprAST> expr;
+    ExprAST* expr;
 
-    OmgAST(std::shared_ptr<ExprAST> expr): expr{std::move(expr)} {}
+    OmgAST(ExprAST* expr): expr{expr} {}
 
     std::string stringify(size_t indent_level = 0);
     virtual llvm::Value* codegen(Context& ctx);
+    virtual NodeIndex flatten(FlatAst& flat);
 };
 
 class ExprStmtAST: public StmtAST {
 public:
-    std::shared_ptr<ExprAST> expr;
+    ExprAST* expr;
 
-    ExprStmtAST(std::shared_ptr<ExprAST> expr): expr{std::move(expr)} {}
+    ExprStmtAST(ExprAST* expr): expr{expr} {}
 
     std::string stringify(size_t indent_level = 0);
     virtual llvm::Value* codegen(Context& ctx);
+    virtual NodeIndex flatten(FlatAst& flat);
 };
 
 class BinaryExprAST: public ExprAST {
 public:
     TokenType op;
-    std::shared_ptr<ExprAST> lhs;
-    std::shared_ptr<ExprAST> rhs;
+    ExprAST* lhs;
+    ExprAST* rhs;
 
-    BinaryExprAST(TokenType op, std::shared_ptr<ExprAST> lhs, std::shared_ptr<ExprAST> rhs):
-        op{op}, lhs{std::move(lhs)}, rhs{std::move(rhs)} {}
+    BinaryExprAST(TokenType op, ExprAST* lhs, ExprAST* rhs):
+        op{op}, lhs{lhs}, rhs{rhs} {}
     
     std::string stringify(size_t indent_level);
     virtual llvm::Value* codegen(Context& ctx);
+    virtual NodeIndex flatten(FlatAst& flat);
+};
+
+class UnaryExprAST: public ExprAST {
+public:
+    TokenType op;
+    ExprAST* operand;
+
+    UnaryExprAST(TokenType op, ExprAST* operand):
+        op{op}, operand{operand} {}
+
+    std::string stringify(size_t indent_level);
+    virtual llvm::Value* codegen(Context& ctx);
+    virtual NodeIndex flatten(FlatAst& flat);
 };
 
 class CallAST: public ExprAST {
 public:
-    std::string callee;
-    std::vector<std::shared_ptr<ExprAST>> arguments;
+    Symbol callee;
+    ArenaSpan<ExprAST*> arguments;
 
-    CallAST(const std::string& callee, std::vector<std::shared_ptr<ExprAST>> arguments):
-        callee{callee}, arguments{std::move(arguments)} {}
+    CallAST(Symbol callee, ArenaSpan<ExprAST*> arguments):
+        callee{callee}, arguments{arguments} {}
     
     std::string stringify(size_t indent_level);
     virtual llvm::Value* codegen(Context& ctx);
+    virtual NodeIndex flatten(FlatAst& flat);
 };
 
 class PrimitiveAST: public ExprAST {
@@ -110,7 +134,7 @@ public:
         uint64_t uint64;
         double float64;
     };
-    std::string string;
+    std::string_view string;
 
     enum ValueType {INVALID, INT64, UINT64, FLOAT64, STRING} value_type;
 
@@ -118,18 +142,20 @@ public:
     PrimitiveAST(int64_t int64): int64{int64}, value_type{ValueType::INT64} {}
     PrimitiveAST(uint64_t uint64): uint64{uint64}, value_type{ValueType::UINT64} {}
     PrimitiveAST(double float64): float64{float64}, value_type{ValueType::FLOAT64} {}
-    PrimitiveAST(std::string string): string{std::move(string)}, value_type{ValueType::STRING} {}
+    PrimitiveAST(std::string_view string): string{string}, value_type{ValueType::STRING} {}
 
     std::string stringify(size_t indent_level = 0);
     virtual llvm::Value* codegen(Context& ctx);
+    virtual NodeIndex flatten(FlatAst& flat);
 };
 
 class VariableAST: public ExprAST {
 public:
-    std::string name;
+    Symbol name;
 
-    VariableAST(const std::string& name): name{name} {}
+    VariableAST(Symbol name): name{name} {}
 
     std::string stringify(size_t indent_level = 0);
     virtual llvm::Value* codegen(Context& ctx);
+    virtual NodeIndex flatten(FlatAst& flat);
 };
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "chung/flat_ast.hpp"
+
+// Hash of a source, the key the AST cache is looked up by
+uint64_t content_hash(std::string_view source);
+
+// Parsed programs kept on disk in their flat form, one file per source content hash, so an unchanged file skips
+// the lexer and the parser entirely. A file is a fixed header followed by the FlatAst tables, each 8-byte aligned:
+//
+//     header   magic, format version, content hash, compiler build, table sizes
+//     kinds    uint8_t per node
+//     ops      uint8_t per node
+//     firsts   uint32_t per node
+//     seconds  uint32_t per node
+//     payloads uint64_t per node
+//     lists    uint32_t per entry
+//     roots    uint32_t per top-level statement
+//     strings  the string pool
+//     names    uint64_t (offset << 32 | length) per distinct name, then the text of the names
+//
+// Files are mapped and their tables copied into the FlatAst in one go each, never node by node. Symbols only mean
+// something to the process that interned them, so named nodes are stored with an index into the name table instead,
+// and mapped back to symbols of the global Interner on load. Tables are checked to hold a program the parser could
+// have built before they are returned, and entries another build of the compiler wrote are never used. Entries are
+// written to a temporary file first and renamed into place, so concurrent compilers never see half a file
+class AstCache {
+public:
+    // Bump whenever the layout, NodeKind, TokenType or the meaning of a payload changes
+    static constexpr uint32_t format_version = 3;
+
+    AstCache(std::string directory);
+
+    // Fills flat and returns true if there is a valid entry for the hash
+    bool load(uint64_t hash, FlatAst& flat) const;
+    bool store(uint64_t hash, const FlatAst& flat) const;
+
+    std::string entry_path(uint64_t hash) const;
+
+private:
+    std::string directory;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+#include "chung/flat_ast.hpp"
+#include "chung/token.hpp"
+
+// Buffered writer over a stdio file. Output is gathered in one fixed buffer and handed to the file in large writes,
+// so each piece of a dump costs a memcpy instead of a stream call. Flushes when destroyed
+class OutputSink {
+public:
+    OutputSink(std::FILE* file, size_t capacity = 64 << 10);
+    ~OutputSink();
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    inline void write(std::string_view text) {
+        if (text.size() > capacity - size) {
+            write_through(text);
+            return;
+        }
+        std::memcpy(buffer.get() + size, text.data(), text.size());
+        size += text.size();
+    }
+
+    inline void put(char c) {
+        if (size == capacity) {
+            flush();
+        }
+        buffer[size++] = c;
+    }
+
+    void write_int(int64_t value);
+    void write_uint(uint64_t value);
+    // Shortest digits that read back as the same double
+    void write_float(double value);
+    // What std::to_string gives, six decimals
+    void write_fixed(double value);
+    void write_tabs(size_t count);
+    // A JSON string literal, quotes and escapes included
+    void write_quoted(std::string_view text);
+
+    // Hands the buffer to the file and flushes the file, so other writers to it can follow
+    void flush();
+
+private:
+    void write_through(std::string_view text);
+
+    std::FILE* file;
+    std::unique_ptr<char[]> buffer;
+    size_t capacity;
+    size_t size;
+};
+
+enum class DumpFormat {
+    // The indented listing `chung parse` always printed
+    HUMAN,
+    // One object holding the tokens and the statements, for tooling
+    JSON,
+    // Compact S-expressions, one statement per line
+    SEXPR
+};
+
+// Streams the tokens and the AST of a program to a sink in one of the formats. The AST is read from its flat form,
+// so programs loaded from the AST cache dump the same as freshly parsed ones. Nothing is built in memory on the way:
+// nodes are written as they are visited and indentation is emitted in place
+class AstDumper {
+public:
+    AstDumper(OutputSink& sink, DumpFormat format);
+
+    void dump_tokens(const TokenStream& tokens);
+    void dump_ast(const FlatAst& flat);
+    // Closes the document, the JSON object wraps both dumps
+    void finish();
+
+    // Flushes the sink, for output from elsewhere to follow
+    inline void flush() {
+        sink.flush();
+    }
+
+private:
+    void begin_section(std::string_view name);
+
+    void dump_human(const FlatAst& flat, NodeIndex node, size_t indent_level);
+    void dump_json(const FlatAst& flat, NodeIndex node);
+    void dump_sexpr(const FlatAst& flat, NodeIndex node);
+
+    OutputSink& sink;
+    DumpFormat format;
+    size_t sections;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Byte classes used by the lexer. Source bytes are raw UTF-8, so everything >= 0x80 is left unclassified
+enum CharClass: uint8_t {
+    CHAR_SPACE = 1 << 0,            // ' ', \t, \n, \v, \f, \r
+    CHAR_DIGIT = 1 << 1,            // [0-9]
+    CHAR_IDENTIFIER_START = 1 << 2, // [a-zA-Z_]
+    CHAR_IDENTIFIER = 1 << 3        // [a-zA-Z0-9_]
+};
+
+constexpr std::array<uint8_t, 256> make_char_classes() {
+    std::array<uint8_t, 256> classes{};
+
+    for (int c = 0; c < 256; c++) {
+        if (c == ' ' || (c >= '\t' && c <= '\r')) {
+            classes[c] |= CHAR_SPACE;
+        }
+        if (c >= '0' && c <= '9') {
+            classes[c] |= CHAR_DIGIT | CHAR_IDENTIFIER;
+        }
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') {
+            classes[c] |= CHAR_IDENTIFIER_START | CHAR_IDENTIFIER;
+        }
+    }
+
+    return classes;
+}
+
+inline constexpr std::array<uint8_t, 256> char_classes = make_char_classes();
+
+inline constexpr bool has_char_class(char c, uint8_t char_class) {
+    return char_classes[static_cast<uint8_t>(c)] & char_class;
+}
+
+inline constexpr bool is_space(char c) { return has_char_class(c, CHAR_SPACE); }
+inline constexpr bool is_digit(char c) { return has_char_class(c, CHAR_DIGIT); }
+inline constexpr bool is_identifier_start(char c) { return has_char_class(c, CHAR_IDENTIFIER_START); }
+inline constexpr bool is_identifier_char(char c) { return has_char_class(c, CHAR_IDENTIFIER); }
+
+// Scanners returning the offset of the first byte at or after pos that ends the run.
+// They pick the widest SIMD implementation the host supports at startup (AVX2, SSE2 or scalar)
+struct CharScanners {
+    size_t (*skip_whitespace)(std::string_view source, size_t pos);
+    size_t (*skip_identifier)(std::string_view source, size_t pos);
+    size_t (*skip_digits)(std::string_view source, size_t pos);
+    // Comment bodies: stops at the '\n' (or the end of the source)
+    size_t (*skip_line)(std::string_view source, size_t pos);
+
+    const char* isa;
+};
+
+const CharScanners& get_char_scanners();
+
+// Most runs are only a few bytes long, so those are finished inline and only longer runs go through the SIMD scanners
+template <uint8_t char_class>
+inline size_t skip_char_class(std::string_view source, size_t pos, size_t (*scanner)(std::string_view, size_t)) {
+    for (size_t inline_end = pos + 8; pos < inline_end; pos++) {
+        if (!has_char_class(source.data()[pos], char_class)) {
+            return pos;
+        }
+    }
+    return scanner(source, pos);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "chung/ast.hpp"
+#include "chung/context.hpp"
+#include "chung/flat_ast.hpp"
+
+// The IR building blocks, shared by the tree (AST::codegen) and the flat (codegen(FlatAst)) code generators
+
+// Creates the function without a body. Only the first function of a name is called by that name
+llvm::Function* declare_function(Context& ctx, Symbol name, llvm::ArrayRef<llvm::Type*> parameter_types);
+// Creates the function with its entry block and points the builder at it
+llvm::Function* begin_function(Context& ctx, Symbol name, llvm::ArrayRef<llvm::Type*> parameter_types);
+void end_function(Context& ctx, llvm::Function* function);
+
+// Looks up a function to call, reporting unknown functions and argument count mismatches
+llvm::Function* find_callee(Context& ctx, Symbol callee, size_t argument_count);
+
+llvm::Value* codegen_binary(Context& ctx, TokenType op, llvm::Value* lhs, llvm::Value* rhs);
+llvm::Value* codegen_unary(Context& ctx, TokenType op, llvm::Value* operand);
+// bits is the value's bit pattern (int64 and float64 included)
+llvm::Value* codegen_primitive(Context& ctx, PrimitiveAST::ValueType value_type, uint64_t bits);
+
+// Nodes [begin, end) of a flat AST
+struct NodeRange {
+    NodeIndex begin;
+    NodeIndex end;
+};
+
+// Splits a program into at most count runs of whole top-level statements, holding about as many nodes each. Every
+// run can be generated into a module of its own
+std::vector<NodeRange> partition_program(const FlatAst& flat, size_t count);
+
+// Generates a whole flattened program in a single forward pass over its nodes
+void codegen(const FlatAst& flat, Context& ctx);
+// Generates one run of a partitioned program. Functions defined before the run are declared, so calls resolve to
+// the same functions as when the whole program goes into one module. Only reads the Interner: the context has to be
+// created, and the prelude set up, where nothing else interns at the same time
+void codegen(const FlatAst& flat, Context& ctx, NodeRange range);
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <map>
+#include <ostream>
+#include <memory>
 #include <functional>
 
 #include "llvm/ADT/APFloat.h"
@@ -15,17 +17,25 @@
 #include "llvm/IR/Type.h"
 #include "llvm/IR/Verifier.h"
 
+#include "chung/interner.hpp"
 #include "chung/type.hpp"
 
 struct Context {
-    llvm::LLVMContext context;
+    // Owned through a pointer so the module can be handed over together with its context, e.g. to the JIT as a
+    // ThreadSafeModule. Nothing can be generated into the Context after that
+    std::unique_ptr<llvm::LLVMContext> owned_context;
+    llvm::LLVMContext& context;
     llvm::IRBuilder<> builder;
     std::unique_ptr<llvm::Module> module;
-    std::map<std::string, llvm::Value*> named_values;
-    std::map<std::string, Type&> declared_types;
+    // Indexed by the symbols of the global Interner
+    SymbolTable<llvm::Value*> named_values;
+    SymbolTable<llvm::Function*> functions;
+    SymbolTable<Type*> declared_types;
     std::map<std::reference_wrapper<const Type>, llvm::Type*, std::less<const Type>> llvm_types;
+    // Where codegen reports problems, std::cerr unless the context is generated on another thread
+    std::ostream* errors;
 
     Context();
 
-    Type& get_type(const std::string& type_identifier);
+    Type& get_type(Symbol type_identifier);
 };
\ No newline at end of file
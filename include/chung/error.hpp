@@ -5,5 +5,5 @@
 class Exception {
 public:
     virtual ~Exception() = default;
-    virtual std::string write() = 0;
-};
\ No newline at end of file
+    virtual std::string write() const = 0;
+};
\ No newline at end of file
@@ -1,7 +1,39 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 // #include "chung/utf.hpp"
 
-std::string read_source(const std::string& file_path);
+// Owns the one and only buffer holding a source file. Regular files are memory-mapped read-only, anything else
+// (stdin as "-", pipes) is read into memory. Either way the contents are followed by a '\0' sentinel for the lexer
+class SourceFile {
+public:
+    SourceFile(const std::string& file_path);
+    ~SourceFile();
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    inline std::string_view get_source() const {
+        return source;
+    }
+
+    inline bool is_open() const {
+        return open;
+    }
+
+private:
+    bool map_file(int fd, size_t size);
+    void read_file(int fd);
+
+    std::string_view source;
+    bool open;
+
+    void* mapping;
+    size_t mapping_size;
+
+    // Fallback when the file can't be mapped
+    std::string buffer;
+};
+
 bool file_exists(const std::string& file_path);
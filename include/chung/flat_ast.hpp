@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "chung/arena.hpp"
+#include "chung/interner.hpp"
+#include "chung/type.hpp"
+
+class StmtAST;
+
+enum class NodeKind: uint8_t {
+    FUNCTION,
+    VAR_DECLARE,
+    OMG,
+    EXPR_STMT,
+    BINARY_EXPR,
+    UNARY_EXPR,
+    CALL,
+    PRIMITIVE,
+    VARIABLE
+};
+
+using NodeIndex = uint32_t;
+inline constexpr NodeIndex no_node = std::numeric_limits<NodeIndex>::max();
+
+// The AST flattened into struct-of-arrays tables, for passes that would rather scan than chase pointers.
+// Children are referenced by 32-bit indices and always come before their parent, so a single forward pass sees
+// every operand before the node using it. Functions are the exception: the FUNCTION node comes first, followed by
+// its parameters and then its body, up to the end index it records.
+//
+//     kind         op                first            second           payload
+//     FUNCTION     -                 list offset      end of function  name symbol
+//     VAR_DECLARE  Ty                expr or no_node  -                name symbol
+//     OMG          -                 expr             -                -
+//     EXPR_STMT    -                 expr             -                -
+//     BINARY_EXPR  TokenType         lhs              rhs              -
+//     UNARY_EXPR   TokenType         operand          -                -
+//     CALL         -                 list offset      -                callee symbol
+//     PRIMITIVE    value type        -                -                value bits, or the string
+//     VARIABLE     -                 -                -                name symbol
+//
+// Lists live in `lists` as a count followed by the node indices: a FUNCTION has its parameters then its body there,
+// a CALL its arguments. Names are Symbols of the global Interner, string literals are kept in one pool and referenced
+// by (offset << 32 | length) payloads
+class FlatAst {
+public:
+    std::vector<NodeKind> kinds;
+    std::vector<uint8_t> ops;
+    std::vector<NodeIndex> firsts;
+    std::vector<NodeIndex> seconds;
+    std::vector<uint64_t> payloads;
+
+    std::vector<uint32_t> lists;
+    std::string strings;
+
+    // Top-level statements, in source order
+    std::vector<NodeIndex> roots;
+
+    inline size_t size() const {
+        return kinds.size();
+    }
+
+    inline NodeIndex push(NodeKind kind, uint8_t op = 0, NodeIndex first = no_node, NodeIndex second = no_node, uint64_t payload = 0) {
+        kinds.push_back(kind);
+        ops.push_back(op);
+        firsts.push_back(first);
+        seconds.push_back(second);
+        payloads.push_back(payload);
+        return static_cast<NodeIndex>(kinds.size() - 1);
+    }
+
+    inline uint64_t add_string(std::string_view string) {
+        uint64_t offset = strings.size();
+        strings.append(string);
+        return offset << 32 | string.size();
+    }
+
+    inline Symbol symbol(NodeIndex node) const {
+        return static_cast<Symbol>(payloads[node]);
+    }
+
+    inline std::string_view string(NodeIndex node) const {
+        uint64_t payload = payloads[node];
+        return std::string_view{strings}.substr(payload >> 32, payload & 0xFFFFFFFF);
+    }
+
+    // Reserves a list of count entries and returns its offset, the entries are filled in afterwards
+    inline uint32_t reserve_list(size_t count) {
+        uint32_t offset = static_cast<uint32_t>(lists.size());
+        lists.push_back(static_cast<uint32_t>(count));
+        lists.resize(lists.size() + count, no_node);
+        return offset;
+    }
+
+    inline ArenaSpan<const NodeIndex> list(uint32_t offset) const {
+        return {lists.data() + offset + 1, lists[offset]};
+    }
+
+    inline ArenaSpan<const NodeIndex> function_parameters(NodeIndex function) const {
+        return list(firsts[function]);
+    }
+
+    inline ArenaSpan<const NodeIndex> function_body(NodeIndex function) const {
+        return list(firsts[function] + 1 + lists[firsts[function]]);
+    }
+
+    inline ArenaSpan<const NodeIndex> call_arguments(NodeIndex call) const {
+        return list(firsts[call]);
+    }
+};
+
+// Whether the payload of the kind of node is a Symbol
+inline bool has_symbol(NodeKind kind) {
+    return kind == NodeKind::FUNCTION || kind == NodeKind::VAR_DECLARE || kind == NodeKind::CALL || kind == NodeKind::VARIABLE;
+}
+
+// Builds the flat form of a parsed program. Holes left by parse errors are skipped
+FlatAst flatten(const std::vector<StmtAST*>& statements);
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "chung/flat_ast.hpp"
+
+// Compile-time evaluation over the flat AST, run between parsing and codegen. One forward pass, in place:
+// operands come before the node using them, so they are already folded when it is reached.
+//
+// Arithmetic (+ - * / % **) on two literals of the same type becomes a literal, as does negation or ~ of one,
+// with the semantics codegen gives the operation at run time:
+//     int64, uint64  two's complement, wrapping on overflow. int64 divisions are truncating. Dividing by zero or
+//                    INT64_MIN / -1 is left to run time, as are uint64 divisions: codegen divides every integer as
+//                    signed for now. The exponent of ** is taken as unsigned
+//     float64        IEEE 754 as the host computes it, % is fmod
+//
+// The rest is simplified where the result is the same value: x * 1, 1 * x, x / 1 and x ** 1 are x, x + 0, 0 + x
+// and x - 0 are x for integers (x + 0.0 would turn -0.0 into 0.0), and x ** 2 is x * x. The operand is computed
+// once either way, nodes only ever refer to its value.
+//
+// References are redirected to the node that replaces a simplified one, which is left behind as an invalid
+// primitive that codegen skips. Node indices and the function ranges stay valid
+void fold_constants(FlatAst& flat);
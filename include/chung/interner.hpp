@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+#include "chung/arena.hpp"
+
+// Dense ID of an interned name, handed out from 0 in the order names are first seen
+using Symbol = uint32_t;
+inline constexpr Symbol no_symbol = std::numeric_limits<Symbol>::max();
+
+// Stores every identifier once and names it by a Symbol, so from the lexer on, names are compared as integers and
+// symbol tables are plain arrays. Texts are copied into an arena and never move, the views handed out stay valid.
+// Interning isn't thread-safe: parallel lexer chunks intern into private interners, merged into the global one after.
+// Reading is, parallel codegen only ever looks up texts
+class Interner {
+public:
+    Interner();
+
+    Interner(const Interner&) = delete;
+    Interner& operator=(const Interner&) = delete;
+
+    // The one shared by the whole compiler, which the lexer fills
+    static Interner& global();
+
+    Symbol intern(std::string_view text);
+    // no_symbol if the text was never interned
+    Symbol find(std::string_view text) const;
+
+    inline std::string_view text(Symbol symbol) const {
+        return texts[symbol];
+    }
+
+    inline size_t size() const {
+        return texts.size();
+    }
+
+private:
+    static uint32_t hash(std::string_view text);
+    void grow();
+
+    AstArena storage;
+    std::vector<std::string_view> texts;
+    std::vector<uint32_t> hashes;
+
+    // Open addressing with linear probing over a power-of-two table, kept at most half full
+    std::vector<Symbol> slots;
+};
+
+// Flat symbol-indexed table, e.g. the values of the names in scope. Lookups are a bounds check and an index.
+// Clearing only resets the entries that were set, so it stays cheap however many symbols there are
+template <typename T>
+class SymbolTable {
+public:
+    inline T get(Symbol symbol) const {
+        return symbol < values.size() ? values[symbol] : T{};
+    }
+
+    inline void set(Symbol symbol, T value) {
+        if (symbol >= values.size()) {
+            values.resize(symbol + 1, T{});
+        }
+        values[symbol] = value;
+        bound.push_back(symbol);
+    }
+
+    inline void clear() {
+        for (Symbol symbol: bound) {
+            values[symbol] = T{};
+        }
+        bound.clear();
+    }
+
+private:
+    std::vector<T> values;
+    std::vector<Symbol> bound;
+};
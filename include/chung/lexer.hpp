@@ -4,6 +4,7 @@
 
 #include "chung/token.hpp"
 #include "chung/error.hpp"
+#include "chung/source_map.hpp"
 
 class LexException: public Exception {
 public:
@@ -11,40 +12,70 @@ public:
 
     size_t start;
     size_t end;
-    size_t line;
-    size_t column;
 
-    std::string source_line;
+    const SourceMap& source_map;
 
-    LexException(const std::string &exception_message, size_t start, size_t end);
-    std::string write();
+    LexException(const std::string &exception_message, size_t start, size_t end, const SourceMap& source_map);
+    std::string write() const;
 };
 
+// A single edit to the source: removed_length bytes at offset were replaced by inserted_text
+struct SourceEdit {
+    uint32_t offset;
+    uint32_t removed_length;
+    std::string_view inserted_text;
+};
+
+// Decodes the escape sequences of a string literal's contents (without the quotes)
+std::string unescape_string(std::string_view string);
+
 class Lexer {
 public:
-    Lexer(const std::string& source);
+    // The source buffer behind the SourceMap is not copied: it has to be NUL-terminated (as std::string is) and outlive the tokens
+    Lexer(const SourceMap& source_map);
 
     inline char advance() {
-        return source[cursor++];
+        return source.data()[cursor++];
     }
 
     inline char peek() {
-        return source[cursor];
-    }
-
-    inline std::vector<std::string> get_source_lines() {
-        return source_lines;
+        return source.data()[cursor];
     }
 
     inline Token make_token(TokenType type, size_t beg, size_t end) {
-        Token token{type, beg, end};
-        token.text = source.substr(beg, end - beg);
+        Token token{type, static_cast<uint32_t>(beg), static_cast<uint32_t>(end)};
+        token.text = token_text(source, token);
         return token;
     }
 
-    std::pair<std::vector<Token>, std::vector<LexException>> lex();
+    inline const std::vector<LexException>& get_exceptions() const {
+        return exceptions;
+    }
+
+    // Lexes and returns a single token, on demand. Exceptions are collected in get_exceptions()
+    Token next();
+    // Lexes the whole source at once. Sources above parallel_lex_threshold are split at newlines and lexed on
+    // all cores, with the exact same result
+    std::pair<TokenStream, std::vector<LexException>> lex();
+    // lex() split into about chunk_count chunks whatever the source size, 1 lexing serially. What lex() runs, exposed
+    // so the parallel path can be checked and measured on its own
+    std::pair<TokenStream, std::vector<LexException>> lex_chunked(size_t chunk_count);
+    // Incrementally re-lexes after an edit. The lexer has to be built over the edited source, while the previous
+    // tokens and exceptions come from lexing the source before the edit. Only the edited range is lexed again
+    std::pair<TokenStream, std::vector<LexException>> relex(TokenStream previous, const std::vector<LexException>& previous_exceptions, const SourceEdit& edit);
+    static constexpr size_t parallel_lex_threshold = 4 << 20;
+
 private:
-    const std::string source;
-    std::vector<std::string> source_lines;
+    // Returns the offsets splitting the source into roughly chunk_count chunks, including 0 and the source size
+    std::vector<size_t> find_chunk_boundaries(size_t chunk_count);
+    std::pair<TokenStream, std::vector<LexException>> lex_parallel(const std::vector<size_t>& boundaries);
+
+    const SourceMap& source_map;
+    std::string_view source;
+    // Where identifiers are interned: the global interner, except for the chunks of a parallel lex
+    Interner* interner;
     size_t cursor;
+    size_t limit;
+
+    std::vector<LexException> exceptions;
 };
\ No newline at end of file
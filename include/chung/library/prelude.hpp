@@ -1,9 +1,17 @@
 #pragma once
 
+#include "llvm/ADT/ArrayRef.h"
+
 #include "chung/context.hpp"
+#include "chung/library/runtime.hpp"
+
+// A prelude function and where it lives in the compiler itself
+struct PreludeSymbol {
+    const char* name;
+    void* address;
+};
 
-extern "C" {
-    void print(int64_t int64);
-}
+void setup_prelude(Context& ctx);
 
-void setup_prelude(Context& ctx);
\ No newline at end of file
+// Every function setup_prelude declares, for `chung run` to resolve calls to inside the compiler process
+llvm::ArrayRef<PreludeSymbol> prelude_symbols();
\ No newline at end of file
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+
+// The part of the prelude compiled programs call at run time. It only needs the C library, so it builds on its own
+// into the prelude archive executables are linked against, and into the compiler for `chung run`
+extern "C" {
+    void print(int64_t int64);
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "llvm/Support/raw_ostream.h"
+
+// Links object files into an executable in-process, with LLD's ELF driver as a library. The program's objects come
+// first, then the prelude archive, then the C library, between the C runtime's start files.
+//
+// Where these live is fixed when the compiler is built, which passes them as defines:
+//     CHUNG_PRELUDE_ARCHIVE  static archive of src/library/runtime.cpp, built alongside the compiler
+//     CHUNG_CRT_DIR          directory holding crt1.o, crti.o, crtn.o and libc
+//     CHUNG_DYNAMIC_LINKER   the program interpreter executables ask for
+// The defaults fit x86-64 glibc systems. Returns false when LLD fails, its diagnostics go to errors
+bool link_executable(const std::vector<std::string>& objects, const std::string& output_path, llvm::raw_ostream& errors);
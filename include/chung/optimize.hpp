@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CodeGen.h"
+#include "llvm/Target/TargetMachine.h"
+
+enum class OptLevel {
+    O0,
+    O1,
+    O2,
+    O3,
+    // -O2, but favoring smaller code
+    Os
+};
+
+// Parses "-O0" to "-O3" and "-Os". Returns false for anything else
+bool parse_opt_level(const std::string& flag, OptLevel& level);
+
+// What the backend should do at the level, for TargetMachine creation
+llvm::CodeGenOpt::Level codegen_opt_level(OptLevel level);
+
+// Runs the new pass manager's default pipeline for the level over the module, tuned for the target machine if there
+// is one. -O0 still runs the O0 pipeline, which only handles always_inline and the like. With time_passes, the time
+// spent in every pass is reported on stderr once the pipeline is done
+void optimize_module(llvm::Module& module, llvm::TargetMachine* target_machine, OptLevel level, bool time_passes);
@@ -1,10 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
 
+#include "chung/arena.hpp"
 #include "chung/ast.hpp"
 #include "chung/context.hpp"
 #include "chung/error.hpp"
+#include "chung/lexer.hpp"
+#include "chung/source_map.hpp"
 #include "chung/utf.hpp"
 
 #define VALIDATE_TOKEN(token_, type, condition)         \
@@ -13,98 +18,207 @@
     }                                                   \
     return current_token().type == type && conditional; \
 
+// A syntax error, recorded rather than thrown. Messages are string literals and the location is a pair of source
+// offsets, so recording one never allocates; lines and columns are only looked up once it is written
 class ParseException: public Exception {
 public:
-    std::string exception_message;
-    Token token;
+    const char* exception_message;
+    uint32_t beg;
+    uint32_t end;
 
-    std::string source_line;
+    const SourceMap& source_map;
 
-    ParseException(const std::string& exception_message, const Token& token, const std::string& source_line);
-    std::string write();
+    ParseException(const char* exception_message, uint32_t beg, uint32_t end, const SourceMap& source_map);
+    std::string write() const;
+};
+
+class Parser;
+
+enum class Associativity: uint8_t {LEFT, RIGHT};
+
+// One entry per TokenType drives the whole expression parser (Pratt style). A token starting an expression is
+// handled by its prefix handler; a token following one is an infix operator if it has a binding power, and it only
+// binds when that power is above the one the surrounding expression was parsed with
+struct ParseRule {
+    using PrefixHandler = ExprAST* (Parser::*)();
+    using InfixHandler = ExprAST* (Parser::*)(ExprAST* lhs, const Token& op, int right_power);
+
+    PrefixHandler prefix;
+    InfixHandler infix;
+    uint8_t power;
+    Associativity associativity;
 };
 
 class Parser {
 public:
-    Parser(const std::vector<Token> tokens, const std::vector<std::string> source_lines, Context& ctx);
-
-    inline Token current_token() {
-        if (tokens_idx >= tokens.size()) {
-            return tokens[tokens.size() - 1];
-        }
-        return tokens[tokens_idx];
+    // Nodes are allocated in the arena, which has to outlive the returned AST
+    Parser(TokenStream tokens, const SourceMap& source_map, Context& ctx, AstArena& arena);
+    // Streaming mode: tokens are pulled from the lexer on demand, so only the lookahead window is ever in memory
+    Parser(Lexer& lexer, const SourceMap& source_map, Context& ctx, AstArena& arena);
+
+    // stream can point at the parser's own tokens, which a copy or a move would leave behind
+    Parser(const Parser&) = delete;
+    Parser& operator=(const Parser&) = delete;
+    Parser(Parser&&) = delete;
+    Parser& operator=(Parser&&) = delete;
+
+    // The cursor hands out references into the lookahead ring. They stay valid until the parser moves two tokens
+    // further, anything kept longer than that has to be copied (a Token is a small trivially copyable view)
+    inline const Token& current_token() {
+        fill_lookahead();
+        return lookahead[tokens_idx % lookahead_size];
     }
 
-    inline Token previous_token() {
+    inline const Token& previous_token() {
         if (tokens_idx == 0) {
-            return tokens[0];
+            return current_token();
         }
-        return tokens[tokens_idx - 1];
+        return lookahead[(tokens_idx - 1) % lookahead_size];
     }
 
-    inline Token next_token() {
-        if (tokens_idx >= tokens.size()) {
-            return tokens[tokens.size() - 1];
-        }
-        return tokens[tokens_idx + 1];
+    inline const Token& next_token() {
+        fill_lookahead();
+        return lookahead[(tokens_idx + 1) % lookahead_size];
     }
 
-    inline Token eat_token() {
-        if (tokens_idx >= tokens.size()) {
-            return tokens[tokens.size() - 1];
+    inline const Token& eat_token() {
+        const Token& token = current_token();
+        // EOF is never eaten, it acts as the sentinel at the end of the stream
+        if (token.type != TokenType::EOF) {
+            tokens_idx++;
         }
-        return tokens[tokens_idx++];
+        return token;
     }
 
     // inline void eat_token_until(std::vector<Token>& tokens) {
     //     while (std::find(tokens.begin(), tokens.end(), eat_token()) != tokens.end()) {}
     // }
 
-    inline ParseException push_exception(const std::string& exception_message, const Token& token) {
-        ParseException exception{exception_message, token, source_lines[token.line - 1]};
-        exceptions.push_back(exception);
-        return exception;
+    // Records the error and puts the parser in panic mode. Parse functions return nullptr while panicking, all the
+    // way up to parse_statement, which synchronizes. A nullptr without panicking just means nothing was parsed
+    inline std::nullptr_t fail(const char* exception_message, const Token& token) {
+        exceptions.emplace_back(exception_message, token.beg, token.end, source_map);
+        panicking = true;
+        return nullptr;
     }
 
-    inline std::vector<ParseException> get_exceptions() {
+    inline const std::vector<ParseException>& get_exceptions() const {
         return exceptions;
     }
 
-    inline void match_simple(TokenType type, const std::string& exception_str) {
+    // Eats the token if it has the type, fails otherwise
+    inline bool match_simple(TokenType type, const char* exception_str) {
         if (current_token().type != type) {
-            throw push_exception(exception_str, current_token());
+            fail(exception_str, current_token());
+            return false;
         }
         eat_token();
+        return true;
     }
 
+    // Skips to the next sync point: past a ';', a '{' or a stray '}', or up to a 'def', a 'let' or the '}' closing
+    // the block being parsed
     void synchronize();
 
-    std::shared_ptr<ExprAST> parse_call();
-    std::shared_ptr<ExprAST> parse_identifier();
-    std::shared_ptr<ExprAST> parse_parentheses();
-    std::shared_ptr<ExprAST> parse_bin_op(int min_op_precedence, std::shared_ptr<ExprAST> lhs);
-    std::shared_ptr<ExprAST> parse_primitive();
-    std::shared_ptr<ExprAST> parse_primary();
+    // Prefix handlers
+    ExprAST* parse_call();
+    ExprAST* parse_identifier();
+    ExprAST* parse_parentheses();
+    ExprAST* parse_primitive();
+    ExprAST* parse_unary();
+
+    // Infix handlers
+    ExprAST* parse_binary(ExprAST* lhs, const Token& op, int right_power);
+    ExprAST* parse_assignment(ExprAST* lhs, const Token& op, int right_power);
     
     // Statements
-    std::vector<std::shared_ptr<StmtAST>> parse_block();
-    std::shared_ptr<StmtAST> parse_var_declaration();
-    std::shared_ptr<StmtAST> parse_function();
-    std::shared_ptr<StmtAST> parse_omg();
-    std::shared_ptr<StmtAST> parse_expression_statement();
+    ArenaSpan<StmtAST*> parse_block();
+    StmtAST* parse_var_declaration();
+    StmtAST* parse_function();
+    StmtAST* parse_omg();
+    StmtAST* parse_expression_statement();
     
     // Heheheha
-    std::shared_ptr<ExprAST> parse_expression();
-    std::shared_ptr<StmtAST> parse_statement();
+    ExprAST* parse_expression(int min_power = 0);
+    StmtAST* parse_statement();
 
-    // For now
-    std::vector<std::shared_ptr<StmtAST>> parse();
+    // For now. A token stream is split into its top-level statements, each parsed on its own so an error is never
+    // recovered from past the end of its statement. Streams above parallel_parse_threshold tokens are parsed on all
+    // cores and merged back in source order, with the exact same result
+    std::vector<StmtAST*> parse();
+    static constexpr size_t parallel_parse_threshold = 256 << 10;
 
 private:
-    std::vector<Token> tokens;
-    std::vector<std::string> source_lines;
+    // Workers parse ranges of a stream owned by another parser
+    Parser(const TokenStream* stream, const SourceMap& source_map, Context& ctx, AstArena& arena);
+
+    // Parses the statements in [first, last) of the stream as if it ended there
+    void parse_range(size_t first, size_t last, std::vector<StmtAST*>& statements);
+
+    // Returns where each top-level statement starts, plus the end of the stream. Statements end at a ';' or a '}'
+    // outside of any braces, so a function is always a single statement, however big its body is
+    std::vector<size_t> find_statement_boundaries() const;
+    std::vector<StmtAST*> parse_parallel(const std::vector<size_t>& boundaries, size_t worker_count);
+
+    // Holds the previous, current and next token
+    static constexpr size_t lookahead_size = 4;
+
+    inline Token pull_token() {
+        if (lexer) {
+            return lexer->next();
+        }
+        if (stream_idx < stream_end) {
+            return (*stream)[stream_idx++];
+        }
+        // Past the end the stream keeps repeating its EOF. A range ending before it gets an empty EOF instead,
+        // placed where the next statement begins
+        if (stream_end < stream->size()) {
+            if (stream->type(stream_end) == TokenType::EOF) {
+                return (*stream)[stream_end];
+            }
+            return Token{TokenType::EOF, stream->beg(stream_end), stream->beg(stream_end)};
+        }
+        return stream->empty() ? Token{TokenType::EOF, 0, 0} : stream->back();
+    }
+
+    // Child lists are gathered on a scratch stack shared by every nesting level, then copied into the arena in one go
+    template <typename T>
+    inline ArenaSpan<T*> pop_children(size_t first) {
+        ArenaSpan<T*> span = arena.copy<T*>(children.begin() + first, children.end());
+        children.resize(first);
+        return span;
+    }
+
+    inline void fill_lookahead() {
+        while (tokens_pulled <= tokens_idx + 1) {
+            lookahead[tokens_pulled % lookahead_size] = pull_token();
+            tokens_pulled++;
+        }
+    }
+
+    TokenStream tokens;
+    // Points at tokens, or at the stream of the parser a worker was split off from
+    const TokenStream* stream;
+    size_t stream_idx;
+    size_t stream_end;
+    Lexer* lexer;
+
+    std::array<Token, lookahead_size> lookahead;
+    size_t tokens_pulled;
+
+    const SourceMap& source_map;
     Context& ctx;
+    AstArena& arena;
+    std::vector<AST*> children;
 
     std::vector<ParseException> exceptions;
+    bool panicking;
+    // Number of blocks being parsed around the current token
+    size_t block_depth;
+    // Blocks whose '{' was skipped while synchronizing, e.g. the body of a function with a broken parameter list.
+    // Their statements are still parsed for the errors in them, then dropped, and their '}' is eaten silently.
+    // block_orphans is the count when the innermost block was opened, only the ones above it are closed in there
+    size_t orphan_braces;
+    size_t block_orphans;
     size_t tokens_idx;
 };
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Line-offset table over a source buffer, built once and shared by the lexer, parser and diagnostics.
+// Tokens only carry byte offsets; lines and columns are resolved lazily with a binary search
+class SourceMap {
+public:
+    SourceMap(std::string_view source);
+
+    // 1-based line containing the byte offset
+    uint32_t line(uint32_t offset) const;
+    // 0-based column of the byte offset within its line
+    uint32_t column(uint32_t offset) const;
+    // Text of a 1-based line, without the newline
+    std::string_view line_text(uint32_t line) const;
+
+    inline std::string_view get_source() const {
+        return source;
+    }
+
+    inline size_t line_count() const {
+        return line_offsets.size();
+    }
+
+private:
+    std::string_view source;
+    std::vector<uint32_t> line_offsets;
+};
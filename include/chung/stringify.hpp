@@ -2,8 +2,18 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 
 #include "chung/ast.hpp"
 
 std::string stringify(const TokenType& op);
-std::string stringify(const Token& token);
\ No newline at end of file
+std::string stringify(const Token& token);
+
+// The same names without building a string, for the AST dumper. Verbose operators and symbols are spelled out,
+// "Add" instead of "+"
+std::string_view token_name(const Token& token);
+const char* stringify_op(const TokenType& op, bool verbose);
+const char* stringify_symbol(const TokenType& symbol, bool verbose);
+const char* stringify_keyword(const TokenType& keyword);
+// Token category: "Identifier", "Operator", "Keyword"...
+const char* stringify_type(const TokenType& type);
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+
+#include "llvm/IR/FMF.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
+
+// What code is generated for, from -march=, -mcpu=, -mattr= and the floating-point options
+struct TargetSettings {
+    // A CPU name LLVM knows, or "native". Empty when not given: parse then targets a generic CPU, run the host's
+    std::string cpu;
+    // "+feature" and "-feature" names separated by commas, over the CPU's own
+    std::string features;
+    // What float operations may assume, put on every one codegen emits
+    llvm::FastMathFlags fast_math;
+    llvm::FPOpFusion::FPOpFusionMode fp_contract = llvm::FPOpFusion::Standard;
+};
+
+// Parses -march=, -mcpu=, -mattr=, -ffast-math, -fno-honor-nans, -fno-honor-infinities, -fno-signed-zeros and
+// -ffp-contract=fast|on|off into the settings. Returns false for anything else
+bool parse_target_option(const std::string& flag, TargetSettings& settings);
+
+// Replaces a "native" CPU with the host's, whose features then come before the ones asked for
+void resolve_native_cpu(TargetSettings& settings);
+
+// The backend's side of the floating-point options, for TargetMachine creation
+llvm::TargetOptions target_options(const TargetSettings& settings);
+
+// Tags every function defined in the module with the target machine's CPU, features and floating-point options.
+// Passes look at the function, not the machine: the vectorizers size their vectors by the function's features, and
+// the backend resets its floating-point options to the function's before generating it
+void apply_target_attributes(llvm::Module& module, const llvm::TargetMachine& target_machine);
@@ -1,17 +1,23 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <iostream>
+#include <string_view>
 #include <vector>
 
+#include "chung/interner.hpp"
+
 #undef EOF
 
-enum class TokenType {
+enum class TokenType: uint8_t {
     EOF, INVALID,
 
     IDENTIFIER,
 
     ADD, SUB, MUL, DIV, MOD, POW,
     BITWISE_AND, BITWISE_OR, BITWISE_NOT,
+    EQUAL, NOT_EQUAL, LESS, LESS_EQUAL, GREATER, GREATER_EQUAL,
     ASSIGN,
 
     OPEN_PARENTHESES, CLOSE_PARENTHESES,
@@ -29,37 +35,220 @@ enum class TokenType {
     STRING
 };
 
+// Binary value of a numeric literal, decoded once by the lexer, or the interned name of an identifier. Zero for
+// every other token
 struct TokenVal {
     union {
         uint64_t uint64;
         int64_t int64;
         double float64;
+        Symbol symbol;
     };
-
-    // L unions (I'm lazy to write a tagged one)
-    std::string identifier;
-    std::u32string string;
 };
 
+// A lightweight view of a single token. Tokens are never stored like this in bulk (see TokenStream),
+// and their text points straight into the source buffer, which has to outlive them
 struct Token {
     TokenType type;
-    size_t beg;
-    size_t end;
+    uint32_t beg;
+    uint32_t end;
+
+    TokenVal value;
+    std::string_view text;
+
+    Token(): type{TokenType::EOF}, beg{0}, end{0}, value{} {}
+    Token(TokenType type, uint32_t beg, uint32_t end):
+        type{type}, beg{beg}, end{end}, value{} {}
+};
+
+inline std::string_view token_text(std::string_view source, const Token& token) {
+    if (token.type == TokenType::STRING) {
+        // Strip the quotes, escapes are only decoded once the parser needs the value
+        return source.substr(token.beg + 1, token.end - token.beg - 2);
+    } else if (token.type == TokenType::EOF) {
+        return {};
+    }
+    return source.substr(token.beg, token.end - token.beg);
+}
+
+// Struct-of-arrays storage for the lexed tokens: 17 bytes per token and no per-token allocation.
+// Lines and columns are not stored, they are resolved from the offsets through a SourceMap when needed
+class TokenStream {
+public:
+    class Iterator {
+    public:
+        Iterator(const TokenStream& stream, size_t idx): stream{stream}, idx{idx} {}
+
+        inline Token operator*() const { return stream[idx]; }
+        inline Iterator& operator++() { idx++; return *this; }
+        inline bool operator!=(const Iterator& other) const { return idx != other.idx; }
+
+    private:
+        const TokenStream& stream;
+        size_t idx;
+    };
+
+    TokenStream() = default;
+    TokenStream(std::string_view source): source{source} {}
+
+    // Streams are only ever moved around, copies have to be asked for
+    TokenStream(TokenStream&&) = default;
+    TokenStream& operator=(TokenStream&&) = default;
+    TokenStream(const TokenStream&) = delete;
+    TokenStream& operator=(const TokenStream&) = delete;
+
+    inline TokenStream clone() const {
+        TokenStream stream{source};
+        stream.types = types;
+        stream.begs = begs;
+        stream.ends = ends;
+        stream.values = values;
+        return stream;
+    }
+
+    inline void push_back(const Token& token) {
+        types.push_back(token.type);
+        begs.push_back(token.beg);
+        ends.push_back(token.end);
+        values.push_back(token.value);
+    }
+
+    inline Token operator[](size_t idx) const {
+        Token token{types[idx], begs[idx], ends[idx]};
+        token.value = values[idx];
+        token.text = token_text(source, token);
+        return token;
+    }
+
+    inline uint32_t beg(size_t idx) const { return begs[idx]; }
+    inline TokenType type(size_t idx) const { return types[idx]; }
+
+    inline void set_source(std::string_view new_source) {
+        source = new_source;
+    }
+
+    // Index of the first token ending at or after the offset
+    size_t first_ending_after(uint32_t offset) const;
+    // Index of the token (at or after from) beginning exactly at the offset, or size() if there is none
+    size_t find_beg(uint32_t beg, size_t from) const;
+    // Replaces the tokens in [first, last) with the replacement and moves every token after them by delta bytes
+    void splice(size_t first, size_t last, const TokenStream& replacement, int64_t delta);
+    // Maps the symbol of every identifier through the table, e.g. from a private interner to the global one
+    void remap_symbols(const std::vector<Symbol>& symbols);
+
+    inline Token back() const { return (*this)[size() - 1]; }
+    inline size_t size() const { return types.size(); }
+    inline bool empty() const { return types.empty(); }
+
+    inline Iterator begin() const { return Iterator{*this, 0}; }
+    inline Iterator end() const { return Iterator{*this, size()}; }
+
+private:
+    std::string_view source;
+
+    std::vector<TokenType> types;
+    std::vector<uint32_t> begs;
+    std::vector<uint32_t> ends;
+    std::vector<TokenVal> values;
+};
+
+// STRING has to stay the last TokenType
+inline constexpr size_t token_type_count = static_cast<size_t>(TokenType::STRING) + 1;
 
-    size_t line_beg;
-    size_t line_end;
+enum TokenCategory: uint8_t {
+    TOKEN_OPERATOR = 1 << 0,
+    TOKEN_SYMBOL = 1 << 1,
+    TOKEN_KEYWORD = 1 << 2,
+    TOKEN_PRIMITIVE = 1 << 3
+};
+
+constexpr std::array<uint8_t, token_type_count> make_token_categories() {
+    std::array<uint8_t, token_type_count> categories{};
+
+    auto mark = [&categories](TokenType first, TokenType last, TokenCategory category) {
+        for (size_t type = static_cast<size_t>(first); type <= static_cast<size_t>(last); type++) {
+            categories[type] |= category;
+        }
+    };
+    mark(TokenType::ADD, TokenType::ASSIGN, TOKEN_OPERATOR);
+    mark(TokenType::OPEN_PARENTHESES, TokenType::SEMICOLON, TOKEN_SYMBOL);
+    mark(TokenType::DEF, TokenType::__OMG, TOKEN_KEYWORD);
+    mark(TokenType::UINT64, TokenType::STRING, TOKEN_PRIMITIVE);
+
+    return categories;
+}
 
-    size_t line;
-    size_t column;
+inline constexpr std::array<uint8_t, token_type_count> token_categories = make_token_categories();
 
-    std::string text;
+inline constexpr bool is_keyword(TokenType keyword) {
+    return token_categories[static_cast<size_t>(keyword)] & TOKEN_KEYWORD;
+}
 
-    Token(TokenType type, size_t beg, size_t end):
-        type{type}, beg{beg}, end{end}, line{0}, column{0} {}
+inline constexpr bool is_symbol(TokenType symbol) {
+    return token_categories[static_cast<size_t>(symbol)] & TOKEN_SYMBOL;
+}
+
+inline constexpr bool is_operator(TokenType op) {
+    return token_categories[static_cast<size_t>(op)] & TOKEN_OPERATOR;
+}
+
+inline constexpr bool is_primitive(TokenType primitive) {
+    return token_categories[static_cast<size_t>(primitive)] & TOKEN_PRIMITIVE;
+}
+
+// Keywords are found through a perfect hash built at compile time, so identifiers cost one table load and one compare.
+// A new keyword only has to be added to the list below; if it collides, the static_assert fires and the hash needs new constants
+struct Keyword {
+    std::string_view text;
+    TokenType type;
 };
 
-bool is_keyword(const std::string& identifier);
+inline constexpr Keyword keywords[] = {
+    {"def", TokenType::DEF},
+    {"let", TokenType::LET},
+    {"__omg", TokenType::__OMG}
+};
 
-bool is_keyword(TokenType keyword);
-bool is_symbol(TokenType symbol);
-bool is_operator(TokenType op);
\ No newline at end of file
+inline constexpr size_t keyword_table_size = 32;
+
+inline constexpr size_t keyword_hash(std::string_view identifier) {
+    return (identifier.size() * 12 + static_cast<uint8_t>(identifier.front()) * 3 + static_cast<uint8_t>(identifier.back())) % keyword_table_size;
+}
+
+constexpr std::array<Keyword, keyword_table_size> make_keyword_table() {
+    std::array<Keyword, keyword_table_size> table{};
+    for (auto& slot: table) {
+        slot = Keyword{"", TokenType::IDENTIFIER};
+    }
+    for (const Keyword& keyword: keywords) {
+        table[keyword_hash(keyword.text)] = keyword;
+    }
+    return table;
+}
+
+inline constexpr std::array<Keyword, keyword_table_size> keyword_table = make_keyword_table();
+
+constexpr bool keyword_hash_is_perfect() {
+    for (const Keyword& keyword: keywords) {
+        if (keyword_table[keyword_hash(keyword.text)].type != keyword.type) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(keyword_hash_is_perfect(), "Keyword hash collision, pick new constants for keyword_hash");
+
+// Maps identifier text to its keyword TokenType, or IDENTIFIER if it isn't one
+inline constexpr TokenType keyword_type(std::string_view identifier) {
+    if (identifier.empty()) {
+        return TokenType::IDENTIFIER;
+    }
+
+    const Keyword& keyword = keyword_table[keyword_hash(identifier)];
+    return keyword.text == identifier ? keyword.type : TokenType::IDENTIFIER;
+}
+
+inline constexpr bool is_keyword(std::string_view identifier) {
+    return keyword_type(identifier) != TokenType::IDENTIFIER;
+}
\ No newline at end of file
@@ -30,6 +30,9 @@ public:
 
     Type(Ty ty, std::string name): ty{ty}, name{std::move(name)} {};
 
+    // The builtin type behind a Ty
+    static Type& from_ty(Ty ty);
+
     inline virtual bool operator <(const Type& other) const {
         return ty < other.ty;
     }
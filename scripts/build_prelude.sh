@@ -0,0 +1,20 @@
+#!/bin/sh
+# Builds the prelude archive `chung parse` links every executable against, from src/library/runtime.cpp.
+# It goes to $PREFIX/lib/libchung_prelude.a, where src/link.cpp looks by default. With another PREFIX, compile
+# src/link.cpp with -DCHUNG_PRELUDE_ARCHIVE='"<PREFIX>/lib/libchung_prelude.a"' to match
+set -eu
+
+root=$(cd "$(dirname "$0")/.." && pwd)
+prefix=${PREFIX:-/usr/local}
+cxx=${CXX:-c++}
+ar=${AR:-ar}
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# Position independent so it links into PIE executables too
+"$cxx" -std=c++17 -O2 -fPIC -I"$root/include" -c "$root/src/library/runtime.cpp" -o "$work/runtime.o"
+mkdir -p "$prefix/lib"
+"$ar" rcs "$work/libchung_prelude.a" "$work/runtime.o"
+mv "$work/libchung_prelude.a" "$prefix/lib/libchung_prelude.a"
+echo "$prefix/lib/libchung_prelude.a"
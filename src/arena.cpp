@@ -0,0 +1,34 @@
+#include "chung/arena.hpp"
+
+AstArena::AstArena(size_t block_size):
+    blocks{}, cursor{nullptr}, limit{nullptr}, block_size{block_size}, total_bytes{0} {}
+
+void* AstArena::allocate_slow(size_t size, size_t alignment) {
+    // Oversized requests get a block of their own, the rest of the current block isn't worth throwing away
+    size_t new_block_size = size + alignment > block_size ? size + alignment : block_size;
+
+    char* block = blocks.emplace_back(new char[new_block_size]).get();
+    total_bytes += new_block_size;
+
+    if (new_block_size != block_size) {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(block) + alignment - 1) & ~(alignment - 1);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    cursor = block;
+    limit = block + block_size;
+    return allocate(size, alignment);
+}
+
+void AstArena::adopt(AstArena&& other) {
+    // The current block stays the one being bumped, only its unused tail is left out of bytes_allocated()
+    for (auto& block: other.blocks) {
+        blocks.push_back(std::move(block));
+    }
+    total_bytes += other.bytes_allocated();
+
+    other.blocks.clear();
+    other.cursor = nullptr;
+    other.limit = nullptr;
+    other.total_bytes = 0;
+}
@@ -0,0 +1,428 @@
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "chung/ast.hpp"
+#include "chung/ast_cache.hpp"
+
+// XXH64 with a zero seed: 32 bytes per round over 4 independent lanes, then the tail
+static constexpr uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t prime3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t read64(const char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint32_t read32(const char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static inline uint64_t xxh_round(uint64_t acc, uint64_t input) {
+    return rotl(acc + input * prime2, 31) * prime1;
+}
+
+static inline uint64_t merge_round(uint64_t hash, uint64_t lane) {
+    return (hash ^ xxh_round(0, lane)) * prime1 + prime4;
+}
+
+// Everything is stored in native byte order, caches live next to the build and aren't shared across machines
+struct CacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t hash;
+    uint64_t build;
+    uint64_t node_count;
+    uint64_t list_size;
+    uint64_t root_count;
+    uint64_t string_size;
+    uint64_t name_count;
+    uint64_t name_size;
+};
+
+static constexpr char cache_magic[8] = {'C', 'H', 'U', 'N', 'G', 'A', 'S', 'T'};
+
+static inline size_t align8(size_t size) {
+    return (size + 7) & ~size_t{7};
+}
+
+// Size of the file holding the tables, header included
+static inline size_t entry_size(const CacheHeader& header) {
+    return sizeof(CacheHeader) + align8(header.node_count) * 2 + align8(header.node_count * 4) * 2 + header.node_count * 8 +
+        align8(header.list_size * 4) + align8(header.root_count * 4) + align8(header.string_size) + header.name_count * 8 +
+        align8(header.name_size);
+}
+
+template <typename T>
+static inline void write_table(std::string& out, const std::vector<T>& table) {
+    out.append(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(T));
+    out.resize(align8(out.size()), '\0');
+}
+
+template <typename T>
+static inline const char* read_table(const char* in, std::vector<T>& table, size_t size) {
+    table.resize(size);
+    std::memcpy(table.data(), in, size * sizeof(T));
+    return in + align8(size * sizeof(T));
+}
+
+// Identity of the running compiler. A parser that changes what it produces without changing the layout would
+// otherwise keep loading what the old one built, so every build has entries of its own: the executable's size, inode
+// and modification time change whenever it is rebuilt. Zero if it can't be told, no entry is loaded then
+static uint64_t compiler_build() {
+    static const uint64_t build = [] {
+        struct stat exe_stat;
+        if (stat("/proc/self/exe", &exe_stat) != 0) {
+            return uint64_t{0};
+        }
+
+        uint64_t key[4] = {
+            static_cast<uint64_t>(exe_stat.st_size), static_cast<uint64_t>(exe_stat.st_ino),
+            static_cast<uint64_t>(exe_stat.st_mtim.tv_sec), static_cast<uint64_t>(exe_stat.st_mtim.tv_nsec)
+        };
+        uint64_t hash = content_hash(std::string_view{reinterpret_cast<const char*>(key), sizeof(key)});
+        return hash != 0 ? hash : 1;
+    }();
+    return build;
+}
+
+// Whether a child is an operand: one of the expressions between the start of its statement and its parent
+static inline bool valid_operand(const FlatAst& flat, NodeIndex operand, NodeIndex statement_begin, NodeIndex parent) {
+    if (operand < statement_begin || operand >= parent) {
+        return false;
+    }
+    NodeKind kind = flat.kinds[operand];
+    return kind == NodeKind::BINARY_EXPR || kind == NodeKind::UNARY_EXPR || kind == NodeKind::CALL ||
+        kind == NodeKind::PRIMITIVE || kind == NodeKind::VARIABLE;
+}
+
+static inline bool valid_statement(const FlatAst& flat, NodeIndex statement) {
+    NodeKind kind = flat.kinds[statement];
+    return kind == NodeKind::FUNCTION || kind == NodeKind::VAR_DECLARE || kind == NodeKind::OMG || kind == NodeKind::EXPR_STMT;
+}
+
+// Whether a list of the given offset fits in the lists table
+static inline bool valid_list(const FlatAst& flat, uint64_t offset) {
+    return offset < flat.lists.size() && offset + 1 + flat.lists[offset] <= flat.lists.size();
+}
+
+// Whether the nodes of the top-level statement in [begin, end) fit together, root being the statement itself. Operands
+// are expressions of the same statement coming before their parent. A function is the statement or lies inside
+// another one, and its parameters and body come between it and its end
+static bool valid_statement_nodes(const FlatAst& flat, NodeIndex begin, NodeIndex end, NodeIndex root) {
+    // Ends of the functions around the node
+    std::vector<NodeIndex> function_ends;
+
+    for (NodeIndex node = begin; node < end; node++) {
+        NodeIndex first = flat.firsts[node];
+        NodeIndex second = flat.seconds[node];
+        uint8_t op = flat.ops[node];
+        bool valid = true;
+
+        switch (flat.kinds[node]) {
+            case NodeKind::FUNCTION: {
+                NodeIndex function_end = function_ends.empty() ? end : function_ends.back();
+                valid = (node == root || !function_ends.empty()) && second > node && second <= function_end &&
+                    valid_list(flat, first) && valid_list(flat, uint64_t{first} + 1 + flat.lists[first]);
+                if (valid) {
+                    // Parameters have a type of their own and no value
+                    for (NodeIndex parameter: flat.function_parameters(node)) {
+                        valid = valid && parameter > node && parameter < second && flat.kinds[parameter] == NodeKind::VAR_DECLARE &&
+                            flat.firsts[parameter] == no_node && flat.ops[parameter] >= static_cast<uint8_t>(Ty::TUINT64) &&
+                            flat.ops[parameter] <= static_cast<uint8_t>(Ty::TSTRING);
+                    }
+                    for (NodeIndex statement: flat.function_body(node)) {
+                        valid = valid && statement > node && statement < second && valid_statement(flat, statement);
+                    }
+                    function_ends.push_back(second);
+                }
+                break;
+            }
+            case NodeKind::VAR_DECLARE:
+                valid = (first == no_node || valid_operand(flat, first, begin, node)) && op <= static_cast<uint8_t>(Ty::TSTRING);
+                break;
+            case NodeKind::OMG:
+            case NodeKind::EXPR_STMT:
+                valid = valid_operand(flat, first, begin, node);
+                break;
+            case NodeKind::BINARY_EXPR:
+                valid = valid_operand(flat, second, begin, node);
+                [[fallthrough]];
+            case NodeKind::UNARY_EXPR:
+                valid = valid && valid_operand(flat, first, begin, node) && op <= static_cast<uint8_t>(TokenType::STRING) &&
+                    is_operator(static_cast<TokenType>(op));
+                break;
+            case NodeKind::CALL:
+                valid = valid_list(flat, first);
+                if (valid) {
+                    for (NodeIndex argument: flat.call_arguments(node)) {
+                        valid = valid && valid_operand(flat, argument, begin, node);
+                    }
+                }
+                break;
+            case NodeKind::PRIMITIVE:
+                valid = op <= PrimitiveAST::ValueType::STRING;
+                if (valid && op == PrimitiveAST::ValueType::STRING) {
+                    uint64_t string = flat.payloads[node];
+                    valid = (string >> 32) + (string & 0xFFFFFFFF) <= flat.strings.size();
+                }
+                break;
+            case NodeKind::VARIABLE:
+                break;
+            default:
+                valid = false;
+                break;
+        }
+        if (!valid) {
+            return false;
+        }
+
+        while (!function_ends.empty() && function_ends.back() == node + 1) {
+            function_ends.pop_back();
+        }
+    }
+    return function_ends.empty();
+}
+
+// Whether the tables hold a program flatten could have built, every later pass indexes them without a check. The
+// top-level statements cover all the nodes in order, each one starting where the one before it ended
+static bool valid_tables(const FlatAst& flat) {
+    size_t node_count = flat.size();
+    NodeIndex begin = 0;
+
+    for (NodeIndex root: flat.roots) {
+        if (root < begin || root >= node_count || !valid_statement(flat, root)) {
+            return false;
+        }
+
+        // A function comes before its parameters and body, any other statement after its operands
+        NodeIndex end = root + 1;
+        if (flat.kinds[root] == NodeKind::FUNCTION) {
+            if (root != begin || flat.seconds[root] <= root || flat.seconds[root] > node_count) {
+                return false;
+            }
+            end = flat.seconds[root];
+        }
+
+        if (!valid_statement_nodes(flat, begin, end, root)) {
+            return false;
+        }
+        begin = end;
+    }
+    return begin == node_count;
+}
+
+uint64_t content_hash(std::string_view source) {
+    const char* p = source.data();
+    const char* end = p + source.size();
+    uint64_t hash;
+
+    if (source.size() >= 32) {
+        uint64_t v1 = prime1 + prime2;
+        uint64_t v2 = prime2;
+        uint64_t v3 = 0;
+        uint64_t v4 = 0 - prime1;
+
+        for (; p + 32 <= end; p += 32) {
+            v1 = xxh_round(v1, read64(p));
+            v2 = xxh_round(v2, read64(p + 8));
+            v3 = xxh_round(v3, read64(p + 16));
+            v4 = xxh_round(v4, read64(p + 24));
+        }
+
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = merge_round(hash, v1);
+        hash = merge_round(hash, v2);
+        hash = merge_round(hash, v3);
+        hash = merge_round(hash, v4);
+    } else {
+        hash = prime5;
+    }
+
+    hash += source.size();
+    for (; p + 8 <= end; p += 8) {
+        hash = rotl(hash ^ xxh_round(0, read64(p)), 27) * prime1 + prime4;
+    }
+    if (p + 4 <= end) {
+        hash = rotl(hash ^ (read32(p) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        hash = rotl(hash ^ (static_cast<uint8_t>(*p) * prime5), 11) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+AstCache::AstCache(std::string directory): directory{std::move(directory)} {}
+
+std::string AstCache::entry_path(uint64_t hash) const {
+    static const char digits[] = "0123456789abcdef";
+
+    std::string name(16, '0');
+    for (size_t i = 0; i < 16; i++) {
+        name[15 - i] = digits[(hash >> (i * 4)) & 0xF];
+    }
+    return std::filesystem::path{directory} / (name + ".ast");
+}
+
+bool AstCache::load(uint64_t hash, FlatAst& flat) const {
+    int fd = ::open(entry_path(hash).c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(CacheHeader)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = file_stat.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    const char* data = static_cast<const char*>(mapping);
+    CacheHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    // A stale, truncated or corrupted entry is a miss, the caller parses and stores a fresh one. So is one another
+    // build of the compiler wrote
+    uint64_t build = compiler_build();
+    bool valid = std::memcmp(header.magic, cache_magic, sizeof(cache_magic)) == 0 && header.version == format_version &&
+        header.hash == hash && build != 0 && header.build == build && header.node_count < no_node &&
+        header.list_size <= size && header.root_count <= size && header.string_size <= size && header.name_count <= size &&
+        header.name_size <= size && entry_size(header) == size;
+
+    if (valid) {
+        const char* in = data + sizeof(CacheHeader);
+        in = read_table(in, flat.kinds, header.node_count);
+        in = read_table(in, flat.ops, header.node_count);
+        in = read_table(in, flat.firsts, header.node_count);
+        in = read_table(in, flat.seconds, header.node_count);
+        in = read_table(in, flat.payloads, header.node_count);
+        in = read_table(in, flat.lists, header.list_size);
+        in = read_table(in, flat.roots, header.root_count);
+        flat.strings.assign(in, header.string_size);
+        in += align8(header.string_size);
+
+        const char* names = in + header.name_count * 8;
+        std::vector<Symbol> symbols(header.name_count);
+        for (size_t i = 0; i < symbols.size() && valid; i++) {
+            uint64_t name = read64(in + i * 8);
+            // Identifiers are never empty
+            valid = (name & 0xFFFFFFFF) != 0 && (name >> 32) + (name & 0xFFFFFFFF) <= header.name_size;
+            if (valid) {
+                symbols[i] = Interner::global().intern(std::string_view{names + (name >> 32), name & 0xFFFFFFFF});
+            }
+        }
+
+        for (NodeIndex node = 0; node < flat.size() && valid; node++) {
+            if (has_symbol(flat.kinds[node])) {
+                valid = flat.payloads[node] < symbols.size();
+                flat.payloads[node] = valid ? symbols[flat.payloads[node]] : 0;
+            }
+        }
+
+        valid = valid && valid_tables(flat);
+    }
+
+    munmap(mapping, size);
+    if (!valid) {
+        flat = FlatAst{};
+    }
+    return valid;
+}
+
+bool AstCache::store(uint64_t hash, const FlatAst& flat) const {
+    CacheHeader header{};
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = format_version;
+    header.hash = hash;
+    header.build = compiler_build();
+    header.node_count = flat.size();
+    header.list_size = flat.lists.size();
+    header.root_count = flat.roots.size();
+    header.string_size = flat.strings.size();
+
+    // Named nodes point into the name table, each name is written once
+    const Interner& interner = Interner::global();
+    std::vector<uint64_t> payloads = flat.payloads;
+    std::vector<uint32_t> name_indices(interner.size(), no_symbol);
+    std::vector<uint64_t> name_table;
+    std::string names;
+
+    for (NodeIndex node = 0; node < flat.size(); node++) {
+        if (has_symbol(flat.kinds[node])) {
+            Symbol symbol = flat.symbol(node);
+            if (name_indices[symbol] == no_symbol) {
+                std::string_view name = interner.text(symbol);
+                name_indices[symbol] = static_cast<uint32_t>(name_table.size());
+                name_table.push_back(static_cast<uint64_t>(names.size()) << 32 | name.size());
+                names.append(name);
+            }
+            payloads[node] = name_indices[symbol];
+        }
+    }
+    header.name_count = name_table.size();
+    header.name_size = names.size();
+
+    std::string out;
+    out.reserve(entry_size(header));
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_table(out, flat.kinds);
+    write_table(out, flat.ops);
+    write_table(out, flat.firsts);
+    write_table(out, flat.seconds);
+    write_table(out, payloads);
+    write_table(out, flat.lists);
+    write_table(out, flat.roots);
+    out.append(flat.strings);
+    out.resize(align8(out.size()), '\0');
+    write_table(out, name_table);
+    out.append(names);
+    out.resize(align8(out.size()), '\0');
+
+    std::error_code errcode;
+    std::filesystem::create_directories(directory, errcode);
+    if (errcode) {
+        return false;
+    }
+
+    std::string path = entry_path(hash);
+    std::string temporary_path = path + '.' + std::to_string(getpid());
+    std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+    file.write(out.data(), out.size());
+    file.close();
+    if (!file) {
+        std::filesystem::remove(temporary_path, errcode);
+        return false;
+    }
+
+    std::filesystem::rename(temporary_path, path, errcode);
+    return !errcode;
+}
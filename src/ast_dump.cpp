@@ -0,0 +1,554 @@
+#include <charconv>
+#include <cmath>
+
+#include "chung/ast.hpp"
+#include "chung/ast_dump.hpp"
+#include "chung/stringify.hpp"
+
+#include "chung/utils/ansi.hpp"
+
+OutputSink::OutputSink(std::FILE* file, size_t capacity): file{file}, buffer{new char[capacity]}, capacity{capacity}, size{0} {}
+
+OutputSink::~OutputSink() {
+    flush();
+}
+
+void OutputSink::write_through(std::string_view text) {
+    flush();
+    if (text.size() > capacity) {
+        std::fwrite(text.data(), 1, text.size(), file);
+        return;
+    }
+    std::memcpy(buffer.get(), text.data(), text.size());
+    size = text.size();
+}
+
+void OutputSink::write_int(int64_t value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    write(std::string_view{digits, static_cast<size_t>(result.ptr - digits)});
+}
+
+void OutputSink::write_uint(uint64_t value) {
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    write(std::string_view{digits, static_cast<size_t>(result.ptr - digits)});
+}
+
+void OutputSink::write_float(double value) {
+    char digits[32];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value);
+    write(std::string_view{digits, static_cast<size_t>(result.ptr - digits)});
+}
+
+void OutputSink::write_fixed(double value) {
+    // DBL_MAX takes 309 digits before the point
+    char digits[320];
+    auto result = std::to_chars(digits, digits + sizeof(digits), value, std::chars_format::fixed, 6);
+    write(std::string_view{digits, static_cast<size_t>(result.ptr - digits)});
+}
+
+void OutputSink::write_tabs(size_t count) {
+    static const char tabs[] = "\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t\t";
+    for (; count > 16; count -= 16) {
+        write(std::string_view{tabs, 16});
+    }
+    write(std::string_view{tabs, count});
+}
+
+void OutputSink::write_quoted(std::string_view text) {
+    static const char hex[] = "0123456789abcdef";
+
+    put('"');
+    size_t run = 0;
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+
+        // Plain characters go out in runs, up to the next one needing an escape
+        write(text.substr(run, i - run));
+        run = i + 1;
+
+        put('\\');
+        switch (c) {
+            case '"': put('"'); break;
+            case '\\': put('\\'); break;
+            case '\n': put('n'); break;
+            case '\r': put('r'); break;
+            case '\t': put('t'); break;
+            default:
+                write("u00");
+                put(hex[c >> 4]);
+                put(hex[c & 0xF]);
+                break;
+        }
+    }
+    write(text.substr(run));
+    put('"');
+}
+
+void OutputSink::flush() {
+    if (size != 0) {
+        std::fwrite(buffer.get(), 1, size, file);
+        size = 0;
+    }
+    std::fflush(file);
+}
+
+AstDumper::AstDumper(OutputSink& sink, DumpFormat format): sink{sink}, format{format}, sections{0} {}
+
+void AstDumper::begin_section(std::string_view name) {
+    sink.write(sections++ == 0 ? "{" : ",\n");
+    sink.write_quoted(name);
+    sink.put(':');
+}
+
+void AstDumper::dump_tokens(const TokenStream& tokens) {
+    switch (format) {
+        case DumpFormat::HUMAN:
+            for (Token token: tokens) {
+                sink.put('|');
+                sink.write(ANSI_BOLD);
+                sink.write(token_name(token));
+                sink.write(ANSI_RESET);
+                sink.write("| ");
+            }
+            sink.write("\n\n");
+            break;
+        case DumpFormat::JSON: {
+            begin_section("tokens");
+            sink.put('[');
+
+            bool first = true;
+            for (Token token: tokens) {
+                sink.write(first ? "{\"type\":" : ",{\"type\":");
+                sink.write_quoted(stringify_type(token.type));
+                sink.write(",\"text\":");
+                sink.write_quoted(token.text);
+                sink.write(",\"beg\":");
+                sink.write_uint(token.beg);
+                sink.write(",\"end\":");
+                sink.write_uint(token.end);
+                sink.put('}');
+                first = false;
+            }
+            sink.put(']');
+            break;
+        }
+        case DumpFormat::SEXPR:
+            sink.write("(tokens");
+            for (Token token: tokens) {
+                sink.write(" (");
+                sink.write(stringify_type(token.type));
+                sink.put(' ');
+                sink.write_quoted(token.text);
+                sink.put(')');
+            }
+            sink.write(")\n");
+            break;
+    }
+}
+
+void AstDumper::dump_ast(const FlatAst& flat) {
+    switch (format) {
+        case DumpFormat::HUMAN:
+            for (NodeIndex root: flat.roots) {
+                dump_human(flat, root, 0);
+                sink.put('\n');
+            }
+            break;
+        case DumpFormat::JSON:
+            begin_section("statements");
+            sink.write("[\n");
+            for (size_t i = 0; i < flat.roots.size(); i++) {
+                dump_json(flat, flat.roots[i]);
+                sink.write(i + 1 < flat.roots.size() ? ",\n" : "\n");
+            }
+            sink.put(']');
+            break;
+        case DumpFormat::SEXPR:
+            for (NodeIndex root: flat.roots) {
+                dump_sexpr(flat, root);
+                sink.put('\n');
+            }
+            break;
+    }
+}
+
+void AstDumper::finish() {
+    if (format == DumpFormat::JSON) {
+        sink.write(sections == 0 ? "{}\n" : "}\n");
+        sections = 0;
+    }
+}
+
+// Same layout as the stringify methods of the tree, byte for byte
+void AstDumper::dump_human(const FlatAst& flat, NodeIndex node, size_t indent_level) {
+    const Interner& interner = Interner::global();
+    NodeIndex first = flat.firsts[node];
+    NodeIndex second = flat.seconds[node];
+
+    switch (flat.kinds[node]) {
+        case NodeKind::FUNCTION: {
+            auto parameters = flat.function_parameters(node);
+
+            sink.write_tabs(indent_level);
+            sink.write("Function Declaration:\n\t");
+            sink.write_tabs(indent_level);
+            sink.write("Name: ");
+            sink.write(interner.text(flat.symbol(node)));
+            sink.write("\n\t");
+            sink.write_tabs(indent_level);
+            sink.write("Parameters:");
+
+            for (size_t i = 0; i < parameters.size(); i++) {
+                sink.write("\n\t\t");
+                sink.write_tabs(indent_level);
+                sink.write("Parameter ");
+                sink.write_uint(i);
+                sink.write(": ");
+                sink.write(interner.text(flat.symbol(parameters[i])));
+            }
+            if (parameters.size() == 0) {
+                sink.write("\n\t\tNo Parameters");
+            }
+            break;
+        }
+        case NodeKind::VAR_DECLARE:
+            sink.write_tabs(indent_level);
+            sink.write("Variable Declaration:\n\t");
+            sink.write_tabs(indent_level);
+            sink.write("Name: ");
+            sink.write(interner.text(flat.symbol(node)));
+            sink.write("\n\t");
+            sink.write_tabs(indent_level);
+            sink.write("Value:\n");
+            if (first != no_node) {
+                dump_human(flat, first, indent_level + 2);
+            }
+            break;
+        case NodeKind::OMG:
+            sink.write_tabs(indent_level);
+            sink.write("Secret OMG:\n");
+            sink.write_tabs(indent_level);
+            dump_human(flat, first, indent_level + 1);
+            break;
+        case NodeKind::EXPR_STMT:
+            sink.write_tabs(indent_level);
+            sink.write("Expression Statement:\n");
+            sink.write_tabs(indent_level);
+            dump_human(flat, first, indent_level + 1);
+            break;
+        case NodeKind::BINARY_EXPR:
+            sink.write_tabs(indent_level);
+            sink.write("Binary Operation:\n\t");
+            sink.write_tabs(indent_level);
+            sink.write("Operator: ");
+            sink.write(stringify_op(static_cast<TokenType>(flat.ops[node]), true));
+
+            // 2 new indentation level: 1 for "Binary Operation" and another for the side
+            sink.write("\n\t");
+            sink.write_tabs(indent_level);
+            sink.write("Left Hand:\n");
+            dump_human(flat, first, indent_level + 2);
+            sink.write("\n\t");
+            sink.write_tabs(indent_level);
+            sink.write("Right Hand:\n");
+            dump_human(flat, second, indent_level + 2);
+            break;
+        case NodeKind::UNARY_EXPR:
+            sink.write_tabs(indent_level);
+            sink.write("Unary Operation:\n\t");
+            sink.write_tabs(indent_level);
+            sink.write("Operator: ");
+            sink.write(stringify_op(static_cast<TokenType>(flat.ops[node]), true));
+            sink.write("\n\t");
+            sink.write_tabs(indent_level);
+            sink.write("Operand:\n");
+            dump_human(flat, first, indent_level + 2);
+            break;
+        case NodeKind::CALL: {
+            auto arguments = flat.call_arguments(node);
+
+            sink.write_tabs(indent_level);
+            sink.write("Call:\n\t");
+            sink.write_tabs(indent_level);
+            sink.write("Name: ");
+            sink.write(interner.text(flat.symbol(node)));
+            sink.write("\n\t");
+            sink.write_tabs(indent_level);
+            sink.write("Arguments:\n");
+
+            for (size_t i = 0; i < arguments.size(); i++) {
+                sink.write_tabs(indent_level);
+                sink.write("\t\tArgument ");
+                sink.write_uint(i + 1);
+                sink.write(":\n");
+                dump_human(flat, arguments[i], indent_level + 3);
+            }
+            break;
+        }
+        case NodeKind::PRIMITIVE: {
+            uint64_t bits = flat.payloads[node];
+
+            sink.write_tabs(indent_level);
+            switch (flat.ops[node]) {
+                case PrimitiveAST::ValueType::INT64:
+                    sink.write("Int64: ");
+                    sink.write_int(static_cast<int64_t>(bits));
+                    break;
+                case PrimitiveAST::ValueType::UINT64:
+                    sink.write("UInt64: ");
+                    sink.write_uint(bits);
+                    break;
+                case PrimitiveAST::ValueType::FLOAT64: {
+                    double float64;
+                    std::memcpy(&float64, &bits, sizeof(float64));
+                    sink.write("Float64: ");
+                    sink.write_fixed(float64);
+                    break;
+                }
+                case PrimitiveAST::ValueType::STRING:
+                    sink.write("String: \"");
+                    sink.write(flat.string(node));
+                    sink.put('"');
+                    break;
+                default:
+                    sink.write("Invalid");
+                    break;
+            }
+            sink.put('\n');
+            break;
+        }
+        case NodeKind::VARIABLE:
+            sink.write("Amogus");
+            break;
+    }
+}
+
+void AstDumper::dump_json(const FlatAst& flat, NodeIndex node) {
+    const Interner& interner = Interner::global();
+    NodeIndex first = flat.firsts[node];
+    NodeIndex second = flat.seconds[node];
+
+    // Writes the nodes of a list as a JSON array
+    auto dump_list = [&](ArenaSpan<const NodeIndex> nodes) {
+        sink.put('[');
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (i != 0) {
+                sink.put(',');
+            }
+            dump_json(flat, nodes[i]);
+        }
+        sink.put(']');
+    };
+
+    switch (flat.kinds[node]) {
+        case NodeKind::FUNCTION:
+            sink.write("{\"kind\":\"function\",\"name\":");
+            sink.write_quoted(interner.text(flat.symbol(node)));
+            sink.write(",\"parameters\":");
+            dump_list(flat.function_parameters(node));
+            sink.write(",\"body\":");
+            dump_list(flat.function_body(node));
+            sink.put('}');
+            break;
+        case NodeKind::VAR_DECLARE:
+            sink.write("{\"kind\":\"let\",\"name\":");
+            sink.write_quoted(interner.text(flat.symbol(node)));
+            sink.write(",\"type\":");
+            sink.write_quoted(Type::from_ty(static_cast<Ty>(flat.ops[node])).name);
+            sink.write(",\"value\":");
+            if (first != no_node) {
+                dump_json(flat, first);
+            } else {
+                sink.write("null");
+            }
+            sink.put('}');
+            break;
+        case NodeKind::OMG:
+            sink.write("{\"kind\":\"omg\",\"expr\":");
+            dump_json(flat, first);
+            sink.put('}');
+            break;
+        case NodeKind::EXPR_STMT:
+            sink.write("{\"kind\":\"expression\",\"expr\":");
+            dump_json(flat, first);
+            sink.put('}');
+            break;
+        case NodeKind::BINARY_EXPR:
+            sink.write("{\"kind\":\"binary\",\"op\":");
+            sink.write_quoted(stringify_op(static_cast<TokenType>(flat.ops[node]), false));
+            sink.write(",\"lhs\":");
+            dump_json(flat, first);
+            sink.write(",\"rhs\":");
+            dump_json(flat, second);
+            sink.put('}');
+            break;
+        case NodeKind::UNARY_EXPR:
+            sink.write("{\"kind\":\"unary\",\"op\":");
+            sink.write_quoted(stringify_op(static_cast<TokenType>(flat.ops[node]), false));
+            sink.write(",\"operand\":");
+            dump_json(flat, first);
+            sink.put('}');
+            break;
+        case NodeKind::CALL:
+            sink.write("{\"kind\":\"call\",\"callee\":");
+            sink.write_quoted(interner.text(flat.symbol(node)));
+            sink.write(",\"arguments\":");
+            dump_list(flat.call_arguments(node));
+            sink.put('}');
+            break;
+        case NodeKind::PRIMITIVE: {
+            uint64_t bits = flat.payloads[node];
+
+            switch (flat.ops[node]) {
+                case PrimitiveAST::ValueType::INT64:
+                    sink.write("{\"kind\":\"int64\",\"value\":");
+                    sink.write_int(static_cast<int64_t>(bits));
+                    break;
+                case PrimitiveAST::ValueType::UINT64:
+                    sink.write("{\"kind\":\"uint64\",\"value\":");
+                    sink.write_uint(bits);
+                    break;
+                case PrimitiveAST::ValueType::FLOAT64: {
+                    double float64;
+                    std::memcpy(&float64, &bits, sizeof(float64));
+                    sink.write("{\"kind\":\"float64\",\"value\":");
+                    // JSON has no infinities, literals too large for a double come out as null
+                    if (std::isfinite(float64)) {
+                        sink.write_float(float64);
+                    } else {
+                        sink.write("null");
+                    }
+                    break;
+                }
+                case PrimitiveAST::ValueType::STRING:
+                    sink.write("{\"kind\":\"string\",\"value\":");
+                    sink.write_quoted(flat.string(node));
+                    break;
+                default:
+                    sink.write("{\"kind\":\"invalid\"");
+                    break;
+            }
+            sink.put('}');
+            break;
+        }
+        case NodeKind::VARIABLE:
+            sink.write("{\"kind\":\"variable\",\"name\":");
+            sink.write_quoted(interner.text(flat.symbol(node)));
+            sink.put('}');
+            break;
+    }
+}
+
+// (def name ((parameter type)...) statement...), (let name type value), (omg expr), (call name argument...),
+// operators as (op operand...). Expression statements are just their expression
+void AstDumper::dump_sexpr(const FlatAst& flat, NodeIndex node) {
+    const Interner& interner = Interner::global();
+    NodeIndex first = flat.firsts[node];
+    NodeIndex second = flat.seconds[node];
+
+    switch (flat.kinds[node]) {
+        case NodeKind::FUNCTION: {
+            auto parameters = flat.function_parameters(node);
+
+            sink.write("(def ");
+            sink.write(interner.text(flat.symbol(node)));
+            sink.write(" (");
+            for (size_t i = 0; i < parameters.size(); i++) {
+                sink.write(i == 0 ? "(" : " (");
+                sink.write(interner.text(flat.symbol(parameters[i])));
+                sink.put(' ');
+                sink.write(Type::from_ty(static_cast<Ty>(flat.ops[parameters[i]])).name);
+                sink.put(')');
+            }
+            sink.put(')');
+            for (NodeIndex stmt: flat.function_body(node)) {
+                sink.put(' ');
+                dump_sexpr(flat, stmt);
+            }
+            sink.put(')');
+            break;
+        }
+        case NodeKind::VAR_DECLARE:
+            sink.write("(let ");
+            sink.write(interner.text(flat.symbol(node)));
+            sink.put(' ');
+            sink.write(Type::from_ty(static_cast<Ty>(flat.ops[node])).name);
+            if (first != no_node) {
+                sink.put(' ');
+                dump_sexpr(flat, first);
+            }
+            sink.put(')');
+            break;
+        case NodeKind::OMG:
+            sink.write("(omg ");
+            dump_sexpr(flat, first);
+            sink.put(')');
+            break;
+        case NodeKind::EXPR_STMT:
+            dump_sexpr(flat, first);
+            break;
+        case NodeKind::BINARY_EXPR:
+            sink.put('(');
+            sink.write(stringify_op(static_cast<TokenType>(flat.ops[node]), false));
+            sink.put(' ');
+            dump_sexpr(flat, first);
+            sink.put(' ');
+            dump_sexpr(flat, second);
+            sink.put(')');
+            break;
+        case NodeKind::UNARY_EXPR:
+            sink.put('(');
+            sink.write(stringify_op(static_cast<TokenType>(flat.ops[node]), false));
+            sink.put(' ');
+            dump_sexpr(flat, first);
+            sink.put(')');
+            break;
+        case NodeKind::CALL:
+            sink.write("(call ");
+            sink.write(interner.text(flat.symbol(node)));
+            for (NodeIndex argument: flat.call_arguments(node)) {
+                sink.put(' ');
+                dump_sexpr(flat, argument);
+            }
+            sink.put(')');
+            break;
+        case NodeKind::PRIMITIVE: {
+            uint64_t bits = flat.payloads[node];
+
+            switch (flat.ops[node]) {
+                case PrimitiveAST::ValueType::INT64:
+                    sink.write_int(static_cast<int64_t>(bits));
+                    break;
+                case PrimitiveAST::ValueType::UINT64:
+                    // Suffixed like the literal, so the two integer types stay apart
+                    sink.write_uint(bits);
+                    sink.put('u');
+                    break;
+                case PrimitiveAST::ValueType::FLOAT64: {
+                    double float64;
+                    std::memcpy(&float64, &bits, sizeof(float64));
+                    sink.write_float(float64);
+                    if (std::isfinite(float64) && float64 == std::trunc(float64) && std::fabs(float64) < 1e16) {
+                        sink.write(".0");
+                    }
+                    break;
+                }
+                case PrimitiveAST::ValueType::STRING:
+                    sink.write_quoted(flat.string(node));
+                    break;
+                default:
+                    sink.write("invalid");
+                    break;
+            }
+            break;
+        }
+        case NodeKind::VARIABLE:
+            sink.write(interner.text(flat.symbol(node)));
+            break;
+    }
+}
@@ -0,0 +1,136 @@
+#include "chung/charclass.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHUNG_X86_SIMD
+#endif
+
+template <uint8_t char_class>
+static size_t skip_class_scalar(std::string_view source, size_t pos) {
+    while (pos < source.size() && has_char_class(source[pos], char_class)) {
+        pos++;
+    }
+    return pos;
+}
+
+static size_t skip_line_scalar(std::string_view source, size_t pos) {
+    while (pos < source.size() && source[pos] != '\n' && source[pos] != '\0') {
+        pos++;
+    }
+    return pos;
+}
+
+static const CharScanners scalar_scanners{
+    skip_class_scalar<CHAR_SPACE>,
+    skip_class_scalar<CHAR_IDENTIFIER>,
+    skip_class_scalar<CHAR_DIGIT>,
+    skip_line_scalar,
+    "scalar"
+};
+
+#ifdef CHUNG_X86_SIMD
+
+// Each scanner loads a whole vector, builds a mask of the bytes that continue the run and stops at the first zero bit.
+// Only full vectors inside the source are loaded; the tail is left to the scalar scanner
+#define DEFINE_SIMD_SCANNER(name, target_, vector_, width, load, movemask, match, scalar_tail)        \
+    __attribute__((target(target_)))                                                                 \
+    static size_t name(std::string_view source, size_t pos) {                                        \
+        const char* data = source.data();                                                            \
+        while (pos + width <= source.size()) {                                                       \
+            vector_ c = load(reinterpret_cast<const vector_*>(data + pos));                          \
+            uint32_t stop_mask = ~static_cast<uint32_t>(movemask(match(c)));                         \
+            if (width < 32) {                                                                        \
+                stop_mask &= (1u << (width % 32)) - 1;                                               \
+            }                                                                                        \
+            if (stop_mask) {                                                                         \
+                return pos + __builtin_ctz(stop_mask);                                               \
+            }                                                                                        \
+            pos += width;                                                                            \
+        }                                                                                            \
+        return scalar_tail(source, pos);                                                             \
+    }                                                                                                \
+
+// SSE2. Every byte of interest is ASCII, so the signed compares are fine: bytes >= 0x80 are negative and never match
+__attribute__((target("sse2"))) static inline __m128i in_range_sse2(__m128i c, char lo, char hi) {
+    return _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8(lo - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8(hi + 1)));
+}
+
+__attribute__((target("sse2"))) static inline __m128i match_whitespace_sse2(__m128i c) {
+    return _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), in_range_sse2(c, '\t', '\r'));
+}
+
+__attribute__((target("sse2"))) static inline __m128i match_digit_sse2(__m128i c) {
+    return in_range_sse2(c, '0', '9');
+}
+
+__attribute__((target("sse2"))) static inline __m128i match_identifier_sse2(__m128i c) {
+    __m128i letter = in_range_sse2(_mm_or_si128(c, _mm_set1_epi8(0x20)), 'a', 'z');
+    __m128i underscore = _mm_cmpeq_epi8(c, _mm_set1_epi8('_'));
+    return _mm_or_si128(_mm_or_si128(letter, underscore), match_digit_sse2(c));
+}
+
+__attribute__((target("sse2"))) static inline __m128i match_line_sse2(__m128i c) {
+    __m128i stop = _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(c, _mm_setzero_si128()));
+    return _mm_xor_si128(stop, _mm_set1_epi8(-1));
+}
+
+DEFINE_SIMD_SCANNER(skip_whitespace_sse2, "sse2", __m128i, 16, _mm_loadu_si128, _mm_movemask_epi8, match_whitespace_sse2, skip_class_scalar<CHAR_SPACE>)
+DEFINE_SIMD_SCANNER(skip_identifier_sse2, "sse2", __m128i, 16, _mm_loadu_si128, _mm_movemask_epi8, match_identifier_sse2, skip_class_scalar<CHAR_IDENTIFIER>)
+DEFINE_SIMD_SCANNER(skip_digits_sse2, "sse2", __m128i, 16, _mm_loadu_si128, _mm_movemask_epi8, match_digit_sse2, skip_class_scalar<CHAR_DIGIT>)
+DEFINE_SIMD_SCANNER(skip_line_sse2, "sse2", __m128i, 16, _mm_loadu_si128, _mm_movemask_epi8, match_line_sse2, skip_line_scalar)
+
+// AVX2
+__attribute__((target("avx2"))) static inline __m256i in_range_avx2(__m256i c, char lo, char hi) {
+    return _mm256_and_si256(_mm256_cmpgt_epi8(c, _mm256_set1_epi8(lo - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8(hi + 1), c));
+}
+
+__attribute__((target("avx2"))) static inline __m256i match_whitespace_avx2(__m256i c) {
+    return _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')), in_range_avx2(c, '\t', '\r'));
+}
+
+__attribute__((target("avx2"))) static inline __m256i match_digit_avx2(__m256i c) {
+    return in_range_avx2(c, '0', '9');
+}
+
+__attribute__((target("avx2"))) static inline __m256i match_identifier_avx2(__m256i c) {
+    __m256i letter = in_range_avx2(_mm256_or_si256(c, _mm256_set1_epi8(0x20)), 'a', 'z');
+    __m256i underscore = _mm256_cmpeq_epi8(c, _mm256_set1_epi8('_'));
+    return _mm256_or_si256(_mm256_or_si256(letter, underscore), match_digit_avx2(c));
+}
+
+__attribute__((target("avx2"))) static inline __m256i match_line_avx2(__m256i c) {
+    __m256i stop = _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(c, _mm256_setzero_si256()));
+    return _mm256_xor_si256(stop, _mm256_set1_epi8(-1));
+}
+
+DEFINE_SIMD_SCANNER(skip_whitespace_avx2, "avx2", __m256i, 32, _mm256_loadu_si256, _mm256_movemask_epi8, match_whitespace_avx2, skip_whitespace_sse2)
+DEFINE_SIMD_SCANNER(skip_identifier_avx2, "avx2", __m256i, 32, _mm256_loadu_si256, _mm256_movemask_epi8, match_identifier_avx2, skip_identifier_sse2)
+DEFINE_SIMD_SCANNER(skip_digits_avx2, "avx2", __m256i, 32, _mm256_loadu_si256, _mm256_movemask_epi8, match_digit_avx2, skip_digits_sse2)
+DEFINE_SIMD_SCANNER(skip_line_avx2, "avx2", __m256i, 32, _mm256_loadu_si256, _mm256_movemask_epi8, match_line_avx2, skip_line_sse2)
+
+static const CharScanners sse2_scanners{
+    skip_whitespace_sse2, skip_identifier_sse2, skip_digits_sse2, skip_line_sse2, "sse2"
+};
+
+static const CharScanners avx2_scanners{
+    skip_whitespace_avx2, skip_identifier_avx2, skip_digits_avx2, skip_line_avx2, "avx2"
+};
+
+#endif
+
+const CharScanners& get_char_scanners() {
+    static const CharScanners& scanners = []() -> const CharScanners& {
+#ifdef CHUNG_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return avx2_scanners;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return sse2_scanners;
+        }
+#endif
+        return scalar_scanners;
+    }();
+
+    return scanners;
+}
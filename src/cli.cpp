@@ -1,4 +1,7 @@
+#include <algorithm>
 #include <filesystem>
+#include <sstream>
+#include <thread>
 
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/TargetSelect.h"
@@ -8,12 +11,23 @@
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Target/TargetOptions.h"
 
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Pass.h"
 
+#include "chung/ast_cache.hpp"
+#include "chung/ast_dump.hpp"
+#include "chung/codegen.hpp"
 #include "chung/file.hpp"
+#include "chung/fold.hpp"
+#include "chung/link.hpp"
+#include "chung/optimize.hpp"
 #include "chung/lexer.hpp"
 #include "chung/parser.hpp"
-#include "chung/stringify.hpp"
+#include "chung/target.hpp"
 
 #include "chung/utils/ansi.hpp"
 
@@ -32,88 +46,220 @@ void run_help() {
     std::cout << "Usage:\n";
     std::cout << "    chung [command] [options]\n\n";
     std::cout << "Commands:\n";
-    std::cout << "    chung parse <file.chung>   Lexes and parses the file, then dumps the AST\n";
+    std::cout << "    chung parse <file.chung>   Lexes and parses the file (\"-\" for stdin), then dumps the AST\n";
+    std::cout << "    chung run <file.chung>     Compiles the file in memory and runs its main function\n\n";
+    std::cout << "Parse options:\n";
+    std::cout << "    --format <name>            Dump format: human (default), json or sexpr. The json and sexpr dumps are\n";
+    std::cout << "                               the only output on stdout, everything else goes to stderr\n";
+    std::cout << "    --no-tokens                Skip the token dump\n";
+    std::cout << "    --jobs <n>                 Generate and emit code on n threads, into an object each (default 1, 0 for\n";
+    std::cout << "                               one per core). --time-passes keeps to one\n\n";
+    std::cout << "Parse and run options:\n";
+    std::cout << "    -O0, -O1, -O2, -O3, -Os    Optimization level (default -O0)\n";
+    std::cout << "    --time-passes              Report the time spent in every optimization and codegen pass\n";
+    std::cout << "    -march=<cpu>, -mcpu=<cpu>  CPU to generate code for, native for this machine's (default a generic one\n";
+    std::cout << "                               for parse, the host's for run)\n";
+    std::cout << "    -mattr=<features>          Features to enable or disable over the CPU's own, like +avx2,-fma\n";
+    std::cout << "    -ffast-math                Let float math reassociate, approximate and fuse, and assume the below\n";
+    std::cout << "    -fno-honor-nans            Assume floats are never NaN\n";
+    std::cout << "    -fno-honor-infinities      Assume floats are never infinite\n";
+    std::cout << "    -fno-signed-zeros          Ignore the sign of zero\n";
+    std::cout << "    -ffp-contract=<mode>       Fusing multiplies with adds: fast, on (default, as the IR allows) or off\n";
 }
 
-void run_parse(std::vector<std::string>& args) {
-    std::cout << ANSI_BOLD << "Running Chungussy " << chung_ver_string() << '\n' << ANSI_RESET;
-    if (args.size() != 2) {
-        std::cerr << ANSI_RED << "Expected 1 argument, received " << args.size() - 1 << '\n' << ANSI_RESET;
+struct CompileOptions {
+    std::string file_path;
+    DumpFormat format = DumpFormat::HUMAN;
+    bool dump_tokens = true;
+    OptLevel opt_level = OptLevel::O0;
+    bool time_passes = false;
+    // Threads, and so modules, code is generated with
+    size_t jobs = 1;
+    TargetSettings target;
+};
+
+// Options shared by parse and run, exits on anything unknown. args[0] is the command
+CompileOptions parse_options(std::vector<std::string>& args) {
+    CompileOptions options;
+    std::vector<std::string> positional;
+
+    for (size_t i = 1; i < args.size(); i++) {
+        if (args[i] == "--no-tokens") {
+            options.dump_tokens = false;
+        } else if (parse_opt_level(args[i], options.opt_level)) {
+            continue;
+        } else if (parse_target_option(args[i], options.target)) {
+            continue;
+        } else if (args[i] == "--time-passes") {
+            options.time_passes = true;
+        } else if (args[i] == "--jobs" && i + 1 < args.size()) {
+            const std::string& count = args[++i];
+            if (count.empty() || count.size() > 4 || count.find_first_not_of("0123456789") != std::string::npos) {
+                std::cerr << ANSI_RED << "Invalid job count \"" << count << "\"\n" << ANSI_RESET;
+                std::exit(1);
+            }
+            options.jobs = std::stoul(count);
+            if (options.jobs == 0) {
+                options.jobs = std::max(1u, std::thread::hardware_concurrency());
+            }
+        } else if (args[i] == "--format" && i + 1 < args.size()) {
+            std::string name = args[++i];
+            if (name == "human") {
+                options.format = DumpFormat::HUMAN;
+            } else if (name == "json") {
+                options.format = DumpFormat::JSON;
+            } else if (name == "sexpr") {
+                options.format = DumpFormat::SEXPR;
+            } else {
+                std::cerr << ANSI_RED << "Unknown dump format \"" << name << "\"\n" << ANSI_RESET;
+                std::exit(1);
+            }
+        } else if (args[i].size() > 1 && args[i][0] == '-') {
+            std::cerr << ANSI_RED << "Unknown option \"" << args[i] << "\"\n" << ANSI_RESET;
+            std::exit(1);
+        } else {
+            positional.push_back(args[i]);
+        }
+    }
+
+    if (positional.size() != 1) {
+        std::cerr << ANSI_RED << "Expected 1 argument, received " << positional.size() << '\n' << ANSI_RESET;
         std::exit(1);
     }
-    
-    std::string file_path = args[1];
-    if (!file_exists(file_path)) {
-        std::cerr << ANSI_RED << "File not found: \"" << file_path << "\" cannot be located" << '\n' << ANSI_RESET;
+
+    resolve_native_cpu(options.target);
+
+    options.file_path = positional[0];
+    // "-" reads the source from stdin
+    if (options.file_path != "-" && !file_exists(options.file_path)) {
+        std::cerr << ANSI_RED << "File not found: \"" << options.file_path << "\" cannot be located" << '\n' << ANSI_RESET;
         std::exit(1);
     }
-    std::cout << "Lexing " << file_path << '\n';
 
-    Context ctx{};
-    std::string source = read_source(file_path);
-    Lexer lexer{source};
+    return options;
+}
+
+// Lexes and parses the source into its flat form, or loads that from the AST cache. Progress goes to log, errors to
+// errors and the tokens to the dumper, if there is one. Returns false if there were lex or parse errors
+bool load_program(const CompileOptions& options, const SourceFile& source_file, const SourceMap& source_map, Context& ctx,
+                  std::ostream& log, std::ostream& errors, AstDumper* dumper, FlatAst& flat) {
+    const std::string& file_path = options.file_path;
+
+    // Unchanged sources come straight from the AST cache, skipping the lexer and the parser altogether
+    AstCache ast_cache{"chungbuild/ast"};
+    uint64_t source_hash = content_hash(source_file.get_source());
+
+    if (ast_cache.load(source_hash, flat)) {
+        log << ANSI_GREEN << "Loaded the AST of " << file_path << " from " << ast_cache.entry_path(source_hash) << "\n\n" << ANSI_RESET;
+        return true;
+    }
+
+    log << "Lexing " << file_path << '\n';
+    Lexer lexer{source_map};
 
-    std::vector<Token> tokens;
+    TokenStream tokens;
     std::vector<LexException> lex_exceptions;
     std::tie(tokens, lex_exceptions) = lexer.lex();
 
     if (!lex_exceptions.empty()) {
-        std::cout << ANSI_RED;
+        errors << ANSI_RED;
         for (auto& lex_exception: lex_exceptions) {
-            std::cout << lex_exception.write() << '\n';
+            errors << lex_exception.write() << '\n';
         }
-        std::cout << ANSI_RESET;
+        errors << ANSI_RESET;
     } else {
-        std::cout << ANSI_GREEN << "Successfully lexed with no exceptions!\n\n" << ANSI_RESET;
-        std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET;
-        std::cout << ANSI_BOLD << "                Program Tokens                \n" << ANSI_RESET;
-        std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET;
-        for (auto& token: tokens) {
-            std::cout << '|' << ANSI_BOLD << stringify(token) << ANSI_RESET << "| ";
+        log << ANSI_GREEN << "Successfully lexed with no exceptions!\n\n" << ANSI_RESET;
+        if (dumper && options.dump_tokens) {
+            if (options.format == DumpFormat::HUMAN) {
+                std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET;
+                std::cout << ANSI_BOLD << "                Program Tokens                \n" << ANSI_RESET;
+                std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET;
+            }
+            dumper->dump_tokens(tokens);
+            dumper->flush();
         }
-        std::cout << "\n\n";
-     }
+    }
 
-    std::cout << "Parsing " << file_path << '\n';
-    Parser parser{tokens, lexer.get_source_lines(), ctx};
+    log << "Parsing " << file_path << '\n';
+    AstArena arena;
+    Parser parser{std::move(tokens), source_map, ctx, arena};
     auto statements = parser.parse();
-    auto parse_exceptions = parser.get_exceptions();
+    auto& parse_exceptions = parser.get_exceptions();
 
     if (!parse_exceptions.empty()) {
-        std::cout << ANSI_RED;
+        errors << ANSI_RED;
         for (auto& parse_exception: parse_exceptions) {
-            std::cout << parse_exception.write() << '\n';
+            errors << parse_exception.write() << '\n';
         }
-        std::cout << ANSI_RESET;
+        errors << ANSI_RESET;
     } else {
-        std::cout << ANSI_GREEN << "Successfully parsed with no exceptions!\n\n" << ANSI_RESET;
+        log << ANSI_GREEN << "Successfully parsed with no exceptions!\n\n" << ANSI_RESET;
+    }
+
+    // The dump and codegen run over the flat form, one linear pass each. Only programs without errors are cached,
+    // the others have to be parsed again to report them
+    flat = flatten(statements);
+    if (!lex_exceptions.empty() || !parse_exceptions.empty()) {
+        return false;
+    }
+    ast_cache.store(source_hash, flat);
+    return true;
+}
+
+// Runs task(i) for every partition, task(0) on the calling thread and the others on threads of their own
+template<typename Task>
+void run_partitions(size_t partition_count, Task task) {
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < partition_count; i++) {
+        workers.emplace_back(task, i);
+    }
+    task(0);
+
+    for (std::thread& worker: workers) {
+        worker.join();
     }
+}
 
-    if (!statements.empty()) {
-        setup_prelude(ctx);
+void run_parse(std::vector<std::string>& args) {
+    CompileOptions options = parse_options(args);
+    const std::string& file_path = options.file_path;
+    OptLevel opt_level = options.opt_level;
+    bool time_passes = options.time_passes;
+    size_t jobs = options.jobs;
+    const TargetSettings& target_settings = options.target;
 
-        std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET;
-        std::cout << ANSI_BOLD << "                 Program AST                  \n" << ANSI_RESET;
-        std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET << '\n';
+    // Machine-readable dumps keep stdout to themselves
+    bool human = options.format == DumpFormat::HUMAN;
+    std::ostream& log = human ? std::cout : std::cerr;
 
-        for (auto& statement: statements) {
-            std::cout << statement->stringify() << '\n';
+    log << ANSI_BOLD << "Running Chungussy " << chung_ver_string() << '\n' << ANSI_RESET;
 
-            llvm::Value* statement_value = statement->codegen(ctx);
-            if (statement_value) {
-                statement_value->print(llvm::outs());
-            }
-        }
+    Context ctx{};
+    SourceFile source_file{file_path};
+    SourceMap source_map{source_file.get_source()};
+    FlatAst flat;
+
+    // Dumps are streamed straight to stdout, the sink is flushed before anything else is printed
+    OutputSink out{stdout};
+    AstDumper dumper{out, options.format};
+
+    load_program(options, source_file, source_map, ctx, log, log, &dumper, flat);
 
-        std::cout << "\n\n";
-        std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET;
-        std::cout << ANSI_BOLD << "      Module IR (temporary trust me bro)      \n" << ANSI_RESET;
-        std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET << std::endl;
-        ctx.module->print(llvm::outs(), nullptr);
+    if (!flat.roots.empty()) {
+        if (human) {
+            std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET;
+            std::cout << ANSI_BOLD << "                 Program AST                  \n" << ANSI_RESET;
+            std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET << '\n';
+        }
+        dumper.dump_ast(flat);
+    }
+    dumper.finish();
+    out.flush();
 
-        std::cout << "\nCompiling " << file_path << '\n';
+    if (!flat.roots.empty()) {
+        // After the dump, which shows the program as written
+        fold_constants(flat);
 
-        // Compile to object file
         llvm::InitializeAllTargetInfos();
         llvm::InitializeAllTargets();
         llvm::InitializeAllTargetMCs();
@@ -129,46 +275,203 @@ void run_parse(std::vector<std::string>& args) {
             std::exit(1);
         }
 
-        std::string cpu{"generic"};
-        std::string features{};
+        std::string cpu = target_settings.cpu.empty() ? "generic" : target_settings.cpu;
+        std::string features = target_settings.features;
 
-        llvm::TargetOptions options;
+        llvm::TargetOptions options = target_options(target_settings);
 
         auto rm = std::optional<llvm::Reloc::Model>();
-        auto target_machine = target->createTargetMachine(target_triple, cpu, features, options, rm);
-        
-        ctx.module->setDataLayout(target_machine->createDataLayout());
-        ctx.module->setTargetTriple(target_triple);
+
+        // Every partition of the program goes into a module and an object of its own, with a thread for each. Pass
+        // timers are process-wide, so --time-passes keeps to one
+        std::vector<NodeRange> partitions = partition_program(flat, time_passes ? 1 : jobs);
+        size_t partition_count = partitions.size();
+
+        // The contexts are created and their preludes set up here, on one thread, since that interns names. The
+        // workers only read the Interner. Problems they report are held back and printed in partition order
+        std::vector<std::unique_ptr<Context>> partition_contexts;
+        std::vector<std::ostringstream> partition_errors(partition_count);
+        std::vector<Context*> contexts{&ctx};
+        for (size_t i = 1; i < partition_count; i++) {
+            partition_contexts.push_back(std::make_unique<Context>());
+            contexts.push_back(partition_contexts.back().get());
+            contexts.back()->errors = &partition_errors[i];
+        }
+
+        std::vector<std::unique_ptr<llvm::TargetMachine>> target_machines;
+        for (Context* partition_ctx: contexts) {
+            setup_prelude(*partition_ctx);
+            partition_ctx->builder.setFastMathFlags(target_settings.fast_math);
+            target_machines.emplace_back(target->createTargetMachine(target_triple, cpu, features, options, rm, std::nullopt, codegen_opt_level(opt_level)));
+        }
+
+        // The IR is shown as the pipeline left it
+        std::vector<std::string> partition_ir(partition_count);
+        run_partitions(partition_count, [&](size_t i) {
+            Context& partition_ctx = *contexts[i];
+            codegen(flat, partition_ctx, partitions[i]);
+
+            partition_ctx.module->setDataLayout(target_machines[i]->createDataLayout());
+            partition_ctx.module->setTargetTriple(target_triple);
+            apply_target_attributes(*partition_ctx.module, *target_machines[i]);
+            optimize_module(*partition_ctx.module, target_machines[i].get(), opt_level, time_passes);
+
+            if (human) {
+                llvm::raw_string_ostream ir{partition_ir[i]};
+                partition_ctx.module->print(ir, nullptr);
+            }
+        });
+
+        for (size_t i = 1; i < partition_count; i++) {
+            std::cerr << partition_errors[i].str();
+        }
+
+        if (human) {
+            std::cout << "\n\n";
+            std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET;
+            std::cout << ANSI_BOLD << "      Module IR (temporary trust me bro)      \n" << ANSI_RESET;
+            std::cout << ANSI_CYAN << "==============================================\n" << ANSI_RESET << std::endl;
+            for (const std::string& ir: partition_ir) {
+                llvm::outs() << ir;
+            }
+        }
+
+        log << "\nCompiling " << file_path << '\n';
 
         // Create chungbuild directory
-        std::string output_filename{"output.o"};
         std::filesystem::create_directory("chungbuild");
 
-        std::string output_filepath{std::filesystem::path{"chungbuild"} / output_filename};
-        std::error_code errcode;
-        llvm::raw_fd_ostream dest{output_filepath, errcode, llvm::sys::fs::OF_None};
-
-        if (errcode) {
-            llvm::errs() << "Could not open file: " << errcode.message();
-            std::exit(1);
+        std::vector<std::string> object_paths;
+        for (size_t i = 0; i < partition_count; i++) {
+            std::string output_filename = partition_count == 1 ? "output.o" : "output." + std::to_string(i) + ".o";
+            object_paths.push_back((std::filesystem::path{"chungbuild"} / output_filename).string());
         }
 
-        // Compile to object file
-        llvm::legacy::PassManager pass;
-        auto filetype = llvm::CGFT_ObjectFile;
+        // Compile to object files. The backend still runs on the legacy pass manager, which reports its timings
+        // through the global flag
+        llvm::TimePassesIsEnabled = time_passes;
+        std::vector<std::string> emit_errors(partition_count);
+        run_partitions(partition_count, [&](size_t i) {
+            std::error_code errcode;
+            llvm::raw_fd_ostream dest{object_paths[i], errcode, llvm::sys::fs::OF_None};
+
+            if (errcode) {
+                emit_errors[i] = "Could not open file: " + errcode.message();
+                return;
+            }
+
+            llvm::legacy::PassManager pass;
+            auto filetype = llvm::CGFT_ObjectFile;
+
+            if (target_machines[i]->addPassesToEmitFile(pass, dest, nullptr, filetype)) {
+                emit_errors[i] = "TargetMachine can't emit a file of this type";
+                return;
+            }
+
+            pass.run(*contexts[i]->module);
+        });
+
+        for (const std::string& error: emit_errors) {
+            if (!error.empty()) {
+                llvm::errs() << error;
+                std::exit(1);
+            }
+        }
+        if (time_passes) {
+            llvm::reportAndResetTimings(&llvm::errs());
+        }
 
-        if (target_machine->addPassesToEmitFile(pass, dest, nullptr, filetype)) {
-            llvm::errs() << "TargetMachine can't emit a file of this type";
+        // The prelude comes prebuilt and LLD runs in this process, nothing else is spawned
+        std::string executable_path{std::filesystem::path{"chungbuild"} / "output.out"};
+        if (!link_executable(object_paths, executable_path, llvm::errs())) {
+            llvm::errs() << "Could not link " << executable_path << '\n';
             std::exit(1);
         }
+    }
+}
+
+void run_run(std::vector<std::string>& args) {
+    CompileOptions options = parse_options(args);
+    llvm::ExitOnError exit_on_error{"chung run: "};
+
+    // Only the program's own output goes to stdout, and errors to stderr
+    std::ostream quiet{nullptr};
+
+    // Owned through a pointer to end its life once the module and its LLVMContext went to the JIT, before the JIT
+    // destroys them
+    auto ctx = std::make_unique<Context>();
+    SourceFile source_file{options.file_path};
+    SourceMap source_map{source_file.get_source()};
+    FlatAst flat;
+
+    if (!load_program(options, source_file, source_map, *ctx, quiet, std::cerr, nullptr, flat)) {
+        std::exit(1);
+    }
+
+    fold_constants(flat);
+    setup_prelude(*ctx);
+    ctx->builder.setFastMathFlags(options.target.fast_math);
+
+    // Nothing half generated is run: codegen's reports end the run, as does IR that doesn't verify
+    std::ostringstream codegen_errors;
+    ctx->errors = &codegen_errors;
+    codegen(flat, *ctx);
+    if (!codegen_errors.str().empty()) {
+        std::cerr << ANSI_RED << codegen_errors.str() << ANSI_RESET;
+        std::exit(1);
+    }
+    if (llvm::verifyModule(*ctx->module, &llvm::errs())) {
+        std::cerr << ANSI_RED << "Invalid IR generated for " << options.file_path << '\n' << ANSI_RESET;
+        std::exit(1);
+    }
+
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
 
-        pass.run(*ctx.module);
-        dest.flush();
-        
-        // IDK /shrug
-        system("clang++ $(llvm-config-17 --cxxflags) src/library/prelude.cpp -Iinclude -c -o chungbuild/prelude.o");
-        system((std::string{"clang++ $(llvm-config-17 --ldflags --libs) "} + output_filepath + " chungbuild/prelude.o -o chungbuild/output.out").c_str());
+    // The host's CPU and features, unless a CPU was given. Features given are added over either
+    llvm::orc::JITTargetMachineBuilder machine_builder = exit_on_error(llvm::orc::JITTargetMachineBuilder::detectHost());
+    if (!options.target.cpu.empty()) {
+        machine_builder.setCPU(options.target.cpu);
+        machine_builder.getFeatures() = llvm::SubtargetFeatures{};
     }
+    machine_builder.addFeatures(llvm::SubtargetFeatures{options.target.features}.getFeatures());
+    machine_builder.setOptions(target_options(options.target));
+    machine_builder.setCodeGenOptLevel(codegen_opt_level(options.opt_level));
+    std::unique_ptr<llvm::TargetMachine> target_machine = exit_on_error(machine_builder.createTargetMachine());
+    std::unique_ptr<llvm::orc::LLJIT> jit = exit_on_error(llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(machine_builder).create());
+
+    ctx->module->setDataLayout(jit->getDataLayout());
+    ctx->module->setTargetTriple(jit->getTargetTriple().str());
+    apply_target_attributes(*ctx->module, *target_machine);
+    optimize_module(*ctx->module, target_machine.get(), options.opt_level, options.time_passes);
+
+    // Calls into the prelude land straight in the compiler's own functions, nothing is looked up in libraries
+    llvm::orc::MangleAndInterner mangle{jit->getExecutionSession(), jit->getDataLayout()};
+    llvm::orc::SymbolMap prelude;
+    for (const PreludeSymbol& symbol: prelude_symbols()) {
+        prelude[mangle(symbol.name)] = llvm::orc::ExecutorSymbolDef{llvm::orc::ExecutorAddr::fromPtr(symbol.address), llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable};
+    }
+    exit_on_error(jit->getMainJITDylib().define(llvm::orc::absoluteSymbols(std::move(prelude))));
+
+    // The module goes to the JIT along with its LLVMContext, what's left of ctx refers to that context and goes now
+    exit_on_error(jit->addIRModule(llvm::orc::ThreadSafeModule{std::move(ctx->module), std::move(ctx->owned_context)}));
+    ctx.reset();
+
+    // Machine code is generated by this lookup, on this thread, under the same legacy pass timers as parse
+    llvm::TimePassesIsEnabled = options.time_passes;
+    auto main_symbol = jit->lookup("main");
+    if (!main_symbol) {
+        // A missing main and a module that failed to compile both show up here
+        std::cerr << ANSI_RED << "Could not look up main in " << options.file_path << ": " << llvm::toString(main_symbol.takeError()) << '\n' << ANSI_RESET;
+        std::exit(1);
+    }
+    if (options.time_passes) {
+        llvm::reportAndResetTimings(&llvm::errs());
+    }
+
+    auto main_function = main_symbol->toPtr<void (*)()>();
+    main_function();
+    std::fflush(stdout);
 }
 
 int main(const int argc, const char** argv) {
@@ -188,6 +491,8 @@ int main(const int argc, const char** argv) {
         run_help();
     } else if (command == "parse") {
         run_parse(args);
+    } else if (command == "run") {
+        run_run(args);
     }
 
     return 0;
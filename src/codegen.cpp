@@ -1,4 +1,158 @@
+#include <algorithm>
+#include <cstring>
+
 #include "chung/ast.hpp"
+#include "chung/codegen.hpp"
+
+llvm::Function* declare_function(Context& ctx, Symbol name, llvm::ArrayRef<llvm::Type*> parameter_types) {
+    // FOR NOW RET VOID
+    llvm::FunctionType* function_type = llvm::FunctionType::get(llvm::Type::getVoidTy(ctx.context), parameter_types, false);
+    llvm::Function* function = llvm::Function::Create(function_type, llvm::Function::ExternalLinkage, llvm::StringRef{Interner::global().text(name)}, ctx.module.get());
+
+    // Calls go to the first definition of a name. The others can't be called at all, so they are kept out of the
+    // object's symbols, where LLVM's renamed copies would clash between partitions
+    if (!ctx.functions.get(name)) {
+        ctx.functions.set(name, function);
+    } else {
+        function->setLinkage(llvm::Function::InternalLinkage);
+    }
+
+    return function;
+}
+
+llvm::Function* begin_function(Context& ctx, Symbol name, llvm::ArrayRef<llvm::Type*> parameter_types) {
+    llvm::Function* function = declare_function(ctx, name, parameter_types);
+
+    ctx.named_values.clear();
+
+    // Basic Block
+    llvm::BasicBlock* function_block = llvm::BasicBlock::Create(ctx.context, "entry", function);
+    ctx.builder.SetInsertPoint(function_block);
+
+    return function;
+}
+
+void end_function(Context& ctx, llvm::Function* function) {
+    // Void FOR NOW
+    ctx.builder.CreateRet(nullptr);
+    llvm::verifyFunction(*function);
+}
+
+llvm::Function* find_callee(Context& ctx, Symbol callee, size_t argument_count) {
+    llvm::Function* function = ctx.functions.get(callee);
+    if (!function) {
+        *ctx.errors << "No function named '" << Interner::global().text(callee) << "'\n";
+        return nullptr;
+    }
+
+    size_t expected_num_args = function->arg_size();
+    if (expected_num_args != argument_count) {
+        // "Expected x argument(s) in call to function sussy, got y"
+        *ctx.errors << "Expected " + std::to_string(expected_num_args) + " argument" + (expected_num_args != 1 ? "s " : " ") + "in call to function '" + std::string{Interner::global().text(callee)} +
+            "', got " + std::to_string(argument_count) << '\n';
+        return nullptr;
+    }
+
+    return function;
+}
+
+// Exponentiation by squaring in a loop, the exponent taken as unsigned. Leaves the builder after the loop
+static llvm::Value* codegen_integer_pow(Context& ctx, llvm::Value* base, llvm::Value* exponent) {
+    llvm::Type* type = base->getType();
+    llvm::BasicBlock* entry_block = ctx.builder.GetInsertBlock();
+    llvm::Function* function = entry_block->getParent();
+
+    llvm::BasicBlock* loop_block = llvm::BasicBlock::Create(ctx.context, "pow.loop", function);
+    llvm::BasicBlock* body_block = llvm::BasicBlock::Create(ctx.context, "pow.body", function);
+    llvm::BasicBlock* end_block = llvm::BasicBlock::Create(ctx.context, "pow.end", function);
+    ctx.builder.CreateBr(loop_block);
+
+    ctx.builder.SetInsertPoint(loop_block);
+    llvm::PHINode* result = ctx.builder.CreatePHI(type, 2, "pow.result");
+    llvm::PHINode* square = ctx.builder.CreatePHI(type, 2, "pow.square");
+    llvm::PHINode* bits = ctx.builder.CreatePHI(type, 2, "pow.bits");
+    result->addIncoming(llvm::ConstantInt::get(type, 1), entry_block);
+    square->addIncoming(base, entry_block);
+    bits->addIncoming(exponent, entry_block);
+    ctx.builder.CreateCondBr(ctx.builder.CreateICmpEQ(bits, llvm::ConstantInt::get(type, 0)), end_block, body_block);
+
+    ctx.builder.SetInsertPoint(body_block);
+    llvm::Value* odd = ctx.builder.CreateICmpNE(ctx.builder.CreateAnd(bits, 1), llvm::ConstantInt::get(type, 0));
+    result->addIncoming(ctx.builder.CreateSelect(odd, ctx.builder.CreateMul(result, square), result), body_block);
+    square->addIncoming(ctx.builder.CreateMul(square, square), body_block);
+    bits->addIncoming(ctx.builder.CreateLShr(bits, 1), body_block);
+    ctx.builder.CreateBr(loop_block);
+
+    ctx.builder.SetInsertPoint(end_block);
+    return result;
+}
+
+llvm::Value* codegen_binary(Context& ctx, TokenType op, llvm::Value* lhs, llvm::Value* rhs) {
+    if (!lhs || !rhs) {
+        return nullptr;
+    }
+
+    // TODO: Add type system (wow). Until then integers divide as signed, like int64 literals
+    bool is_float = lhs->getType()->isFloatingPointTy();
+    switch (op) {
+        case TokenType::ADD:
+            return is_float ? ctx.builder.CreateFAdd(lhs, rhs) : ctx.builder.CreateAdd(lhs, rhs);
+        case TokenType::SUB:
+            return is_float ? ctx.builder.CreateFSub(lhs, rhs) : ctx.builder.CreateSub(lhs, rhs);
+        case TokenType::MUL:
+            return is_float ? ctx.builder.CreateFMul(lhs, rhs) : ctx.builder.CreateMul(lhs, rhs);
+        case TokenType::DIV:
+            return is_float ? ctx.builder.CreateFDiv(lhs, rhs) : ctx.builder.CreateSDiv(lhs, rhs);
+        case TokenType::MOD:
+            return is_float ? ctx.builder.CreateFRem(lhs, rhs) : ctx.builder.CreateSRem(lhs, rhs);
+        case TokenType::POW:
+            return is_float ? ctx.builder.CreateBinaryIntrinsic(llvm::Intrinsic::pow, lhs, rhs) : codegen_integer_pow(ctx, lhs, rhs);
+    }
+
+    *ctx.errors << "NOT IMPLEMENTED yet\n";
+    return nullptr;
+}
+
+llvm::Value* codegen_unary(Context& ctx, TokenType op, llvm::Value* operand) {
+    if (!operand) {
+        return nullptr;
+    }
+
+    bool is_float = operand->getType()->isFloatingPointTy();
+    switch (op) {
+        case TokenType::ADD:
+            return operand;
+        case TokenType::SUB:
+            return is_float ? ctx.builder.CreateFNeg(operand) : ctx.builder.CreateNeg(operand);
+        case TokenType::BITWISE_NOT:
+            if (!is_float) {
+                return ctx.builder.CreateNot(operand);
+            }
+            break;
+    }
+
+    *ctx.errors << "NOT IMPLEMENTED yet\n";
+    return nullptr;
+}
+
+llvm::Value* codegen_primitive(Context& ctx, PrimitiveAST::ValueType value_type, uint64_t bits) {
+    switch (value_type) {
+        case PrimitiveAST::ValueType::INT64:
+            return llvm::ConstantInt::get(ctx.context, llvm::APInt{64, bits, true});
+        case PrimitiveAST::ValueType::UINT64:
+            return llvm::ConstantInt::get(ctx.context, llvm::APInt{64, bits, false});
+        case PrimitiveAST::ValueType::FLOAT64: {
+            double float64;
+            std::memcpy(&float64, &bits, sizeof(float64));
+            return llvm::ConstantFP::get(ctx.context, llvm::APFloat{float64});
+        }
+        default:
+            // std::cout << "L\n";
+            return nullptr;
+    }
+}
+
+// Tree codegen
 
 llvm::Value* VarDeclareAST::codegen(Context& ctx) {
     // For now
@@ -7,41 +161,30 @@ llvm::Value* VarDeclareAST::codegen(Context& ctx) {
 
 llvm::Value* FunctionAST::codegen(Context& ctx) {
     std::vector<llvm::Type*> parameter_types;
-    for (auto& parameter: parameters) {
-        parameter_types.push_back(ctx.llvm_types.at(parameter.type));
+    for (auto parameter: parameters) {
+        parameter_types.push_back(ctx.llvm_types.at(parameter->type));
     }
 
-    // FOR NOW RET VOID
-    llvm::FunctionType* function_type = llvm::FunctionType::get(llvm::Type::getVoidTy(ctx.context), parameter_types, false);
-    llvm::Function* function = llvm::Function::Create(function_type, llvm::Function::ExternalLinkage, name, ctx.module.get());
-
-    ctx.named_values.clear();
+    llvm::Function* function = begin_function(ctx, name, parameter_types);
 
     // Set parameter names
     size_t i = 0;
     for (auto& function_parameter: function->args()) {
-        auto& parameter_name = parameters[i++].name;
-        function_parameter.setName(parameter_name);
-        ctx.named_values[parameter_name] = &function_parameter;
+        Symbol parameter_name = parameters[i++]->name;
+        function_parameter.setName(llvm::StringRef{Interner::global().text(parameter_name)});
+        ctx.named_values.set(parameter_name, &function_parameter);
     }
 
-    // Basic Block
-    llvm::BasicBlock* function_block = llvm::BasicBlock::Create(ctx.context, "entry", function);
-    ctx.builder.SetInsertPoint(function_block);
-
-    for (auto& stmt: body) {
+    for (auto stmt: body) {
         stmt->codegen(ctx);
     }
 
-    // Void FOR NOW
-    ctx.builder.CreateRet(nullptr);
-    llvm::verifyFunction(*function);
-
+    end_function(ctx, function);
     return nullptr;
 }
 
 llvm::Value* OmgAST::codegen(Context& ctx) {
-    std::cerr << "NOT IMPLEMENTED yet\n";
+    *ctx.errors << "NOT IMPLEMENTED yet\n";
     return nullptr;
 }
 
@@ -50,41 +193,23 @@ llvm::Value* ExprStmtAST::codegen(Context& ctx) {
 }
 
 llvm::Value* BinaryExprAST::codegen(Context& ctx) {
-    std::cout << "E";
     llvm::Value* lhs_code = lhs->codegen(ctx);
     llvm::Value* rhs_code = rhs->codegen(ctx);
-    if (!lhs_code || !rhs_code) {
-        return nullptr;
-    }
-
-    switch (op) {
-        // TODO: Add type system (wow)
-        case TokenType::ADD:
-            lhs_code->getType()->print(llvm::outs());
-            return ctx.builder.CreateAdd(lhs_code, rhs_code);
-    }
+    return codegen_binary(ctx, op, lhs_code, rhs_code);
+}
 
-    std::cerr << "NOT IMPLEMENTED yet\n";
-    return nullptr;
+llvm::Value* UnaryExprAST::codegen(Context& ctx) {
+    return codegen_unary(ctx, op, operand->codegen(ctx));
 }
 
 llvm::Value* CallAST::codegen(Context& ctx) {
-    llvm::Function* function = ctx.module->getFunction(callee);
+    llvm::Function* function = find_callee(ctx, callee, arguments.size());
     if (!function) {
-        std::cout << "No function named '" + callee + "'\n";
-        return nullptr;
-    }
-
-    size_t expected_num_args = function->arg_size();
-    if (expected_num_args != arguments.size()) {
-        // "Expected x argument(s) in call to function sussy, got y"
-        std::cout << "Expected " + std::to_string(expected_num_args) + " argument" + (expected_num_args != 1 ? "s " : " ") + "in call to function '" + callee +
-            "', got " + std::to_string(arguments.size()) << '\n';
         return nullptr;
     }
 
     std::vector<llvm::Value*> argument_values;
-    for (auto& arg: arguments) {
+    for (auto arg: arguments) {
         argument_values.push_back(arg->codegen(ctx));
         if (!argument_values.back()) {
             return nullptr;
@@ -95,23 +220,157 @@ llvm::Value* CallAST::codegen(Context& ctx) {
 }
 
 llvm::Value* PrimitiveAST::codegen(Context& ctx) {
+    uint64_t bits = 0;
     switch (value_type) {
         case ValueType::INT64:
-            // std::cout << "Int\n";
-            return llvm::ConstantInt::get(ctx.context, llvm::APInt{64, static_cast<uint64_t>(int64), true});
+            bits = static_cast<uint64_t>(int64);
+            break;
         case ValueType::UINT64:
-            // std::cout << "Uint\n";
-            return llvm::ConstantInt::get(ctx.context, llvm::APInt{64, uint64, false});
+            bits = uint64;
+            break;
         case ValueType::FLOAT64:
-            // std::cout << "Float\n";
-            return llvm::ConstantFP::get(ctx.context, llvm::APFloat{float64});
+            std::memcpy(&bits, &float64, sizeof(bits));
+            break;
         default:
-            // std::cout << "L\n";
-            return nullptr;
+            break;
     }
+    return codegen_primitive(ctx, value_type, bits);
 }
 
 llvm::Value* VariableAST::codegen(Context& ctx) {
-    std::cerr << "NOT IMPLEMENTED yet\n";
+    *ctx.errors << "NOT IMPLEMENTED yet\n";
     return nullptr;
-}
\ No newline at end of file
+}
+
+// Flat codegen
+
+static void function_parameter_types(const FlatAst& flat, Context& ctx, NodeIndex function, std::vector<llvm::Type*>& parameter_types) {
+    parameter_types.clear();
+    for (NodeIndex parameter: flat.function_parameters(function)) {
+        parameter_types.push_back(ctx.llvm_types.at(Type::from_ty(static_cast<Ty>(flat.ops[parameter]))));
+    }
+}
+
+std::vector<NodeRange> partition_program(const FlatAst& flat, size_t count) {
+    // A top-level function ends where it says, any other statement at its own node after its operands
+    std::vector<NodeRange> partitions;
+    NodeIndex begin = 0;
+    size_t node_count = flat.size();
+
+    for (NodeIndex root: flat.roots) {
+        if (partitions.size() + 1 >= count) {
+            break;
+        }
+
+        NodeIndex end = flat.kinds[root] == NodeKind::FUNCTION ? flat.seconds[root] : root + 1;
+        if (end >= node_count * (partitions.size() + 1) / count) {
+            partitions.push_back({begin, end});
+            begin = end;
+        }
+    }
+
+    if (partitions.empty() || begin < node_count) {
+        partitions.push_back({begin, static_cast<NodeIndex>(node_count)});
+    }
+    return partitions;
+}
+
+void codegen(const FlatAst& flat, Context& ctx) {
+    codegen(flat, ctx, {0, static_cast<NodeIndex>(flat.size())});
+}
+
+void codegen(const FlatAst& flat, Context& ctx, NodeRange range) {
+    std::vector<llvm::Type*> parameter_types;
+
+    // Functions defined before the range are generated into other modules, calls to them go through declarations
+    for (NodeIndex node = 0; node < range.begin; node++) {
+        if (flat.kinds[node] == NodeKind::FUNCTION && !ctx.functions.get(flat.symbol(node))) {
+            function_parameter_types(flat, ctx, node, parameter_types);
+            declare_function(ctx, flat.symbol(node), parameter_types);
+        }
+    }
+
+    // Operands always come before the node using them, so their values are ready by the time it is reached. They
+    // are indexed from the start of the range, no statement refers to nodes outside of it
+    std::vector<llvm::Value*> values(range.end - range.begin, nullptr);
+    auto value = [&](NodeIndex node) -> llvm::Value*& {
+        return values[node - range.begin];
+    };
+
+    // Functions still open, with the index their nodes end at
+    std::vector<std::pair<llvm::Function*, NodeIndex>> functions;
+    std::vector<llvm::Value*> argument_values;
+
+    for (NodeIndex node = range.begin; node < range.end; node++) {
+        NodeIndex first = flat.firsts[node];
+        NodeIndex second = flat.seconds[node];
+
+        switch (flat.kinds[node]) {
+            case NodeKind::FUNCTION: {
+                auto parameters = flat.function_parameters(node);
+                function_parameter_types(flat, ctx, node, parameter_types);
+
+                llvm::Function* function = begin_function(ctx, flat.symbol(node), parameter_types);
+
+                // Set parameter names
+                size_t i = 0;
+                for (auto& function_parameter: function->args()) {
+                    Symbol parameter_name = flat.symbol(parameters[i++]);
+                    function_parameter.setName(llvm::StringRef{Interner::global().text(parameter_name)});
+                    ctx.named_values.set(parameter_name, &function_parameter);
+                }
+
+                functions.emplace_back(function, second);
+                break;
+            }
+            case NodeKind::VAR_DECLARE:
+                // Parameters have no value
+                value(node) = first != no_node ? value(first) : nullptr;
+                break;
+            case NodeKind::OMG:
+                *ctx.errors << "NOT IMPLEMENTED yet\n";
+                break;
+            case NodeKind::EXPR_STMT:
+                value(node) = value(first);
+                break;
+            case NodeKind::BINARY_EXPR:
+                value(node) = codegen_binary(ctx, static_cast<TokenType>(flat.ops[node]), value(first), value(second));
+                break;
+            case NodeKind::UNARY_EXPR:
+                value(node) = codegen_unary(ctx, static_cast<TokenType>(flat.ops[node]), value(first));
+                break;
+            case NodeKind::CALL: {
+                auto arguments = flat.call_arguments(node);
+                llvm::Function* function = find_callee(ctx, flat.symbol(node), arguments.size());
+                if (!function) {
+                    break;
+                }
+
+                argument_values.clear();
+                for (NodeIndex argument: arguments) {
+                    argument_values.push_back(value(argument));
+                }
+                if (std::find(argument_values.begin(), argument_values.end(), nullptr) == argument_values.end()) {
+                    value(node) = ctx.builder.CreateCall(function, argument_values);
+                }
+                break;
+            }
+            case NodeKind::PRIMITIVE:
+                value(node) = codegen_primitive(ctx, static_cast<PrimitiveAST::ValueType>(flat.ops[node]), flat.payloads[node]);
+                break;
+            case NodeKind::VARIABLE:
+                *ctx.errors << "NOT IMPLEMENTED yet\n";
+                break;
+        }
+
+        // Close every function ending here, a nested one can end together with the one around it
+        while (!functions.empty() && functions.back().second == node + 1) {
+            end_function(ctx, functions.back().first);
+            functions.pop_back();
+
+            if (!functions.empty()) {
+                ctx.builder.SetInsertPoint(&functions.back().first->back());
+            }
+        }
+    }
+}
@@ -1,15 +1,18 @@
+#include <iostream>
+
 #include "chung/context.hpp"
 
 Context::Context():
-    context{llvm::LLVMContext()}, 
+    owned_context{std::make_unique<llvm::LLVMContext>()},
+    context{*owned_context},
     builder{llvm::IRBuilder<>(context)},
-    module{std::make_unique<llvm::Module>("<module sus>", context)} {
-    declared_types = {
-        {"uint64", Type::tuint64},
-        {"int64", Type::tint64},
-        {"float64", Type::tfloat64},
-        {"string", Type::tstring}
-    };
+    module{std::make_unique<llvm::Module>("<module sus>", context)},
+    errors{&std::cerr} {
+    Interner& interner = Interner::global();
+    declared_types.set(interner.intern("uint64"), &Type::tuint64);
+    declared_types.set(interner.intern("int64"), &Type::tint64);
+    declared_types.set(interner.intern("float64"), &Type::tfloat64);
+    declared_types.set(interner.intern("string"), &Type::tstring);
     llvm_types = {
         {Type::tuint64, llvm::Type::getInt64Ty(context)},
         {Type::tint64, llvm::Type::getInt64Ty(context)},
@@ -18,10 +21,10 @@ Context::Context():
     };
 }
 
-Type& Context::get_type(const std::string& type_identifier) {
-    auto result = declared_types.find(type_identifier);
-    if (result == declared_types.end()) {
+Type& Context::get_type(Symbol type_identifier) {
+    Type* type = declared_types.get(type_identifier);
+    if (!type) {
         return Type::tinvalid;
     }
-    return result->second;
+    return *type;
 }
\ No newline at end of file
@@ -1,21 +1,71 @@
 #include <fstream>
-#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "chung/file.hpp"
 
-std::string read_source(const std::string& file_path) {
-    std::ifstream file{file_path};
-    std::stringstream content_buffer;
+SourceFile::SourceFile(const std::string& file_path): source{}, open{false}, mapping{nullptr}, mapping_size{0} {
+    int fd = file_path == "-" ? STDIN_FILENO : ::open(file_path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && S_ISREG(file_stat.st_mode) && file_stat.st_size > 0 && map_file(fd, file_stat.st_size)) {
+        source = std::string_view{static_cast<const char*>(mapping), static_cast<size_t>(file_stat.st_size)};
+    } else {
+        read_file(fd);
+        source = buffer;
+    }
+    open = true;
 
-    if (file.is_open()) {
-        content_buffer << file.rdbuf();
+    if (fd != STDIN_FILENO) {
+        close(fd);
     }
+}
 
-    return content_buffer.str();
+SourceFile::~SourceFile() {
+    if (mapping) {
+        munmap(mapping, mapping_size);
+    }
+}
+
+bool SourceFile::map_file(int fd, size_t size) {
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    // Always leave room for at least one more byte than the file, so there's a '\0' after it
+    mapping_size = (size / page_size + 1) * page_size;
+
+    // Reserve zeroed anonymous memory first, then map the file over the start of it. If the file size is a multiple
+    // of the page size, the sentinel comes from the anonymous page after it; otherwise from the rest of the last page
+    void* reserved = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED) {
+        return false;
+    }
+
+    if (mmap(reserved, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(reserved, mapping_size);
+        return false;
+    }
+    madvise(reserved, size, MADV_SEQUENTIAL);
+
+    mapping = reserved;
+    return true;
+}
+
+void SourceFile::read_file(int fd) {
+    char chunk[65536];
+    ssize_t bytes_read;
+
+    while ((bytes_read = read(fd, chunk, sizeof(chunk))) > 0) {
+        buffer.append(chunk, bytes_read);
+    }
 }
 
 // ... kind of. It just checks for accessability
 bool file_exists(const std::string& file_path) {
     std::ifstream file{file_path};
     return file.good();
-}
\ No newline at end of file
+}
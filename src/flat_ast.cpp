@@ -0,0 +1,101 @@
+#include <cstring>
+
+#include "chung/ast.hpp"
+#include "chung/flat_ast.hpp"
+
+FlatAst flatten(const std::vector<StmtAST*>& statements) {
+    FlatAst flat;
+    for (auto statement: statements) {
+        if (statement) {
+            flat.roots.push_back(statement->flatten(flat));
+        }
+    }
+    return flat;
+}
+
+NodeIndex VarDeclareAST::flatten(FlatAst& flat) {
+    NodeIndex expr_node = expr ? expr->flatten(flat) : no_node;
+    return flat.push(NodeKind::VAR_DECLARE, static_cast<uint8_t>(type.ty), expr_node, no_node, name);
+}
+
+NodeIndex FunctionAST::flatten(FlatAst& flat) {
+    // The function comes before its body, codegen has to open it first
+    NodeIndex function = flat.push(NodeKind::FUNCTION, 0, no_node, no_node, name);
+
+    size_t body_size = 0;
+    for (auto stmt: body) {
+        body_size += stmt != nullptr;
+    }
+
+    uint32_t parameter_list = flat.reserve_list(parameters.size());
+    uint32_t body_list = flat.reserve_list(body_size);
+    flat.firsts[function] = parameter_list;
+
+    for (size_t i = 0; i < parameters.size(); i++) {
+        flat.lists[parameter_list + 1 + i] = parameters[i]->flatten(flat);
+    }
+
+    size_t i = 0;
+    for (auto stmt: body) {
+        if (stmt) {
+            flat.lists[body_list + 1 + i++] = stmt->flatten(flat);
+        }
+    }
+
+    flat.seconds[function] = static_cast<NodeIndex>(flat.size());
+    return function;
+}
+
+NodeIndex OmgAST::flatten(FlatAst& flat) {
+    NodeIndex expr_node = expr->flatten(flat);
+    return flat.push(NodeKind::OMG, 0, expr_node);
+}
+
+NodeIndex ExprStmtAST::flatten(FlatAst& flat) {
+    NodeIndex expr_node = expr->flatten(flat);
+    return flat.push(NodeKind::EXPR_STMT, 0, expr_node);
+}
+
+NodeIndex BinaryExprAST::flatten(FlatAst& flat) {
+    NodeIndex lhs_node = lhs->flatten(flat);
+    NodeIndex rhs_node = rhs->flatten(flat);
+    return flat.push(NodeKind::BINARY_EXPR, static_cast<uint8_t>(op), lhs_node, rhs_node);
+}
+
+NodeIndex UnaryExprAST::flatten(FlatAst& flat) {
+    NodeIndex operand_node = operand->flatten(flat);
+    return flat.push(NodeKind::UNARY_EXPR, static_cast<uint8_t>(op), operand_node);
+}
+
+NodeIndex CallAST::flatten(FlatAst& flat) {
+    uint32_t argument_list = flat.reserve_list(arguments.size());
+    for (size_t i = 0; i < arguments.size(); i++) {
+        flat.lists[argument_list + 1 + i] = arguments[i]->flatten(flat);
+    }
+    return flat.push(NodeKind::CALL, 0, argument_list, no_node, callee);
+}
+
+NodeIndex PrimitiveAST::flatten(FlatAst& flat) {
+    uint64_t payload = 0;
+    switch (value_type) {
+        case ValueType::INT64:
+            payload = static_cast<uint64_t>(int64);
+            break;
+        case ValueType::UINT64:
+            payload = uint64;
+            break;
+        case ValueType::FLOAT64:
+            std::memcpy(&payload, &float64, sizeof(payload));
+            break;
+        case ValueType::STRING:
+            payload = flat.add_string(string);
+            break;
+        default:
+            break;
+    }
+    return flat.push(NodeKind::PRIMITIVE, static_cast<uint8_t>(value_type), no_node, no_node, payload);
+}
+
+NodeIndex VariableAST::flatten(FlatAst& flat) {
+    return flat.push(NodeKind::VARIABLE, 0, no_node, no_node, name);
+}
@@ -0,0 +1,249 @@
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "chung/ast.hpp"
+#include "chung/fold.hpp"
+
+using ValueType = PrimitiveAST::ValueType;
+
+static inline double to_float64(uint64_t bits) {
+    double float64;
+    std::memcpy(&float64, &bits, sizeof(float64));
+    return float64;
+}
+
+static inline uint64_t to_bits(double float64) {
+    uint64_t bits;
+    std::memcpy(&bits, &float64, sizeof(bits));
+    return bits;
+}
+
+// Exponentiation by squaring, wrapping like the loop codegen emits for integer powers
+static uint64_t wrapping_pow(uint64_t base, uint64_t exponent) {
+    uint64_t result = 1;
+    for (; exponent != 0; exponent >>= 1) {
+        if (exponent & 1) {
+            result *= base;
+        }
+        base *= base;
+    }
+    return result;
+}
+
+// Evaluates an operation on two literals of the same type. False when it has to be left to run time
+static bool fold_binary(TokenType op, uint8_t value_type, uint64_t lhs, uint64_t rhs, uint64_t& result) {
+    switch (value_type) {
+        case ValueType::INT64:
+        case ValueType::UINT64:
+            // Unsigned arithmetic wraps, which is exactly two's complement for int64 too
+            switch (op) {
+                case TokenType::ADD:
+                    result = lhs + rhs;
+                    return true;
+                case TokenType::SUB:
+                    result = lhs - rhs;
+                    return true;
+                case TokenType::MUL:
+                    result = lhs * rhs;
+                    return true;
+                case TokenType::DIV:
+                case TokenType::MOD: {
+                    // Codegen can't tell uint64 from int64 yet and divides both as signed, so uint64 divisions are
+                    // left to run time rather than folded to a value they wouldn't have there
+                    if (rhs == 0 || value_type == ValueType::UINT64) {
+                        return false;
+                    }
+
+                    int64_t dividend = static_cast<int64_t>(lhs);
+                    int64_t divisor = static_cast<int64_t>(rhs);
+                    if (dividend == std::numeric_limits<int64_t>::min() && divisor == -1) {
+                        return false;
+                    }
+                    result = static_cast<uint64_t>(op == TokenType::DIV ? dividend / divisor : dividend % divisor);
+                    return true;
+                }
+                case TokenType::POW:
+                    result = wrapping_pow(lhs, rhs);
+                    return true;
+                default:
+                    return false;
+            }
+        case ValueType::FLOAT64: {
+            double a = to_float64(lhs);
+            double b = to_float64(rhs);
+            switch (op) {
+                case TokenType::ADD:
+                    result = to_bits(a + b);
+                    return true;
+                case TokenType::SUB:
+                    result = to_bits(a - b);
+                    return true;
+                case TokenType::MUL:
+                    result = to_bits(a * b);
+                    return true;
+                case TokenType::DIV:
+                    result = to_bits(a / b);
+                    return true;
+                case TokenType::MOD:
+                    result = to_bits(std::fmod(a, b));
+                    return true;
+                case TokenType::POW:
+                    result = to_bits(std::pow(a, b));
+                    return true;
+                default:
+                    return false;
+            }
+        }
+        default:
+            return false;
+    }
+}
+
+static bool fold_unary(TokenType op, uint8_t value_type, uint64_t operand, uint64_t& result) {
+    bool is_integer = value_type == ValueType::INT64 || value_type == ValueType::UINT64;
+    if (!is_integer && value_type != ValueType::FLOAT64) {
+        return false;
+    }
+
+    switch (op) {
+        case TokenType::ADD:
+            result = operand;
+            return true;
+        case TokenType::SUB:
+            // Negating a float flips its sign bit, -0.0 and NaNs included
+            result = is_integer ? 0 - operand : operand ^ (uint64_t{1} << 63);
+            return true;
+        case TokenType::BITWISE_NOT:
+            result = ~operand;
+            return is_integer;
+        default:
+            return false;
+    }
+}
+
+// Whether the node is a numeric literal equal to value, integer or float
+static bool is_literal(const FlatAst& flat, NodeIndex node, uint64_t value) {
+    if (flat.kinds[node] != NodeKind::PRIMITIVE) {
+        return false;
+    }
+
+    switch (flat.ops[node]) {
+        case ValueType::INT64:
+        case ValueType::UINT64:
+            return flat.payloads[node] == value;
+        case ValueType::FLOAT64:
+            return to_float64(flat.payloads[node]) == static_cast<double>(value);
+        default:
+            return false;
+    }
+}
+
+static bool is_integer_literal(const FlatAst& flat, NodeIndex node, uint64_t value) {
+    return flat.kinds[node] == NodeKind::PRIMITIVE && (flat.ops[node] == ValueType::INT64 || flat.ops[node] == ValueType::UINT64) &&
+        flat.payloads[node] == value;
+}
+
+static inline void make_literal(FlatAst& flat, NodeIndex node, uint8_t value_type, uint64_t bits) {
+    flat.kinds[node] = NodeKind::PRIMITIVE;
+    flat.ops[node] = value_type;
+    flat.firsts[node] = no_node;
+    flat.seconds[node] = no_node;
+    flat.payloads[node] = bits;
+}
+
+// Leaves a node nothing refers to anymore as an invalid primitive, which codegen skips
+static inline void remove_node(FlatAst& flat, NodeIndex node) {
+    make_literal(flat, node, ValueType::INVALID, 0);
+}
+
+void fold_constants(FlatAst& flat) {
+    // Where references to each node go: the node itself, unless it was simplified into one of its operands
+    std::vector<NodeIndex> forward(flat.size());
+
+    for (NodeIndex node = 0; node < flat.size(); node++) {
+        forward[node] = node;
+        NodeIndex first = flat.firsts[node];
+        NodeIndex second = flat.seconds[node];
+
+        switch (flat.kinds[node]) {
+            case NodeKind::VAR_DECLARE:
+                if (first != no_node) {
+                    flat.firsts[node] = forward[first];
+                }
+                break;
+            case NodeKind::OMG:
+            case NodeKind::EXPR_STMT:
+                flat.firsts[node] = forward[first];
+                break;
+            case NodeKind::CALL:
+                for (uint32_t i = 0; i < flat.lists[first]; i++) {
+                    flat.lists[first + 1 + i] = forward[flat.lists[first + 1 + i]];
+                }
+                break;
+            case NodeKind::UNARY_EXPR: {
+                NodeIndex operand = forward[first];
+                flat.firsts[node] = operand;
+
+                uint64_t result;
+                if (flat.kinds[operand] == NodeKind::PRIMITIVE &&
+                    fold_unary(static_cast<TokenType>(flat.ops[node]), flat.ops[operand], flat.payloads[operand], result)) {
+                    make_literal(flat, node, flat.ops[operand], result);
+                    remove_node(flat, operand);
+                }
+                break;
+            }
+            case NodeKind::BINARY_EXPR: {
+                NodeIndex lhs = forward[first];
+                NodeIndex rhs = forward[second];
+                flat.firsts[node] = lhs;
+                flat.seconds[node] = rhs;
+
+                TokenType op = static_cast<TokenType>(flat.ops[node]);
+                bool lhs_literal = flat.kinds[lhs] == NodeKind::PRIMITIVE;
+                bool rhs_literal = flat.kinds[rhs] == NodeKind::PRIMITIVE;
+
+                if (lhs_literal && rhs_literal) {
+                    uint64_t result;
+                    if (flat.ops[lhs] == flat.ops[rhs] && fold_binary(op, flat.ops[lhs], flat.payloads[lhs], flat.payloads[rhs], result)) {
+                        make_literal(flat, node, flat.ops[lhs], result);
+                        remove_node(flat, lhs);
+                        remove_node(flat, rhs);
+                    }
+                    break;
+                }
+
+                // One side is a literal at most: the identities keep the other side, x ** 2 squares it
+                NodeIndex kept = no_node;
+                NodeIndex literal = no_node;
+                if (rhs_literal) {
+                    literal = rhs;
+                    if ((op == TokenType::MUL || op == TokenType::DIV || op == TokenType::POW) && is_literal(flat, rhs, 1)) {
+                        kept = lhs;
+                    } else if ((op == TokenType::ADD || op == TokenType::SUB) && is_integer_literal(flat, rhs, 0)) {
+                        kept = lhs;
+                    } else if (op == TokenType::POW && is_literal(flat, rhs, 2)) {
+                        flat.ops[node] = static_cast<uint8_t>(TokenType::MUL);
+                        flat.seconds[node] = lhs;
+                        remove_node(flat, rhs);
+                    }
+                } else if (lhs_literal) {
+                    literal = lhs;
+                    if ((op == TokenType::MUL && is_literal(flat, lhs, 1)) || (op == TokenType::ADD && is_integer_literal(flat, lhs, 0))) {
+                        kept = rhs;
+                    }
+                }
+
+                if (kept != no_node) {
+                    forward[node] = kept;
+                    remove_node(flat, node);
+                    remove_node(flat, literal);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+}
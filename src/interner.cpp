@@ -0,0 +1,65 @@
+#include "chung/interner.hpp"
+
+Interner::Interner(): storage{16 << 10}, slots(256, no_symbol) {}
+
+Interner& Interner::global() {
+    static Interner interner;
+    return interner;
+}
+
+uint32_t Interner::hash(std::string_view text) {
+    // FNV-1a, identifiers are short
+    uint32_t hash = 2166136261u;
+    for (char c: text) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+    }
+    return hash;
+}
+
+Symbol Interner::intern(std::string_view text) {
+    uint32_t text_hash = hash(text);
+    size_t mask = slots.size() - 1;
+
+    for (size_t slot = text_hash & mask;; slot = (slot + 1) & mask) {
+        Symbol symbol = slots[slot];
+        if (symbol == no_symbol) {
+            symbol = static_cast<Symbol>(texts.size());
+            texts.push_back(storage.copy_string(text));
+            hashes.push_back(text_hash);
+            slots[slot] = symbol;
+
+            if (texts.size() * 2 > slots.size()) {
+                grow();
+            }
+            return symbol;
+        }
+        if (hashes[symbol] == text_hash && texts[symbol] == text) {
+            return symbol;
+        }
+    }
+}
+
+Symbol Interner::find(std::string_view text) const {
+    uint32_t text_hash = hash(text);
+    size_t mask = slots.size() - 1;
+
+    for (size_t slot = text_hash & mask;; slot = (slot + 1) & mask) {
+        Symbol symbol = slots[slot];
+        if (symbol == no_symbol || (hashes[symbol] == text_hash && texts[symbol] == text)) {
+            return symbol;
+        }
+    }
+}
+
+void Interner::grow() {
+    slots.assign(slots.size() * 2, no_symbol);
+    size_t mask = slots.size() - 1;
+
+    for (Symbol symbol = 0; symbol < texts.size(); symbol++) {
+        size_t slot = hashes[symbol] & mask;
+        while (slots[slot] != no_symbol) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = symbol;
+    }
+}
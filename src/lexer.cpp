@@ -1,208 +1,234 @@
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <stdexcept>
 #include <string>
-#include <cwctype>
 #include <iostream>
 #include <sstream>
+#include <thread>
 #include <vector>
 
+#include "chung/charclass.hpp"
 #include "chung/lexer.hpp"
 // #include "chung/utf.hpp"
 
 #define HANDLE_SIMPLE(op_, op_name)                                                   \
     case op_name:                                                                 \
-        tokens.push_back(make_token(op_, cursor, cursor + 1));                    \
         advance();                                                                \
-        break;                                                                    \
+        return make_token(op_, cursor - 1, cursor);                               \
+
+// Operators that may be followed by a second character, e.g. '*' and "**"
+#define HANDLE_COMPOUND(op_, compound_op, op_name, second_char)                     \
+    case op_name:                                                                 \
+        advance();                                                                \
+        if (peek() == second_char) {                                              \
+            advance();                                                            \
+            return make_token(compound_op, cursor - 2, cursor);                   \
+        }                                                                         \
+        return make_token(op_, cursor - 1, cursor);                               \
 
 #define HANDLE_ESCAPE_SEQUENCE(char_, actual_char) \
     case char_:                                    \
-        string += actual_char;                     \
-        advance();                                 \
+        unescaped += actual_char;                  \
         break;                                     \
 
-inline bool is_identifier_char(char c) {
-    if (std::isalpha(c) || c == '_') {
-        return true;
-    }
-    return false;
-}
+LexException::LexException(const std::string& exception_message, size_t start, size_t end, const SourceMap& source_map):
+    exception_message{exception_message}, start{start}, end{end}, source_map{source_map} {}
 
-LexException::LexException(const std::string& exception_message, size_t start, size_t end):
-    exception_message{exception_message}, start{start}, end{end} {}
+std::string LexException::write() const {
+    uint32_t line = source_map.line(end);
+    uint32_t column = source_map.column(end) + 1;
 
-std::string LexException::write() {
     std::string string{"LexException at line " + std::to_string(line) + " column " + std::to_string(column) + ":\n"};
-    string += '\t' + source_line + '\n';
+    string += '\t' + std::string{source_map.line_text(line)} + '\n';
     string += exception_message + '\n';
     
     return string;
 }
 
-Lexer::Lexer(const std::string& source): source{source}, source_lines{}, cursor{0} {
-    size_t start = 0;
-    size_t end = 0;
+std::string unescape_string(std::string_view string) {
+    std::string unescaped;
+    unescaped.reserve(string.size());
+
+    for (size_t i = 0; i < string.size(); i++) {
+        if (string[i] != '\\' || i + 1 == string.size()) {
+            unescaped += string[i];
+            continue;
+        }
 
-    while ((end = source.find('\n', start)) != std::string::npos) {
-        source_lines.push_back(source.substr(start, end - start));
-        start = end + 1;
+        switch (string[++i]) {
+            HANDLE_ESCAPE_SEQUENCE('n', '\n')
+            HANDLE_ESCAPE_SEQUENCE('t', '\t')
+            HANDLE_ESCAPE_SEQUENCE('r', '\r')
+            HANDLE_ESCAPE_SEQUENCE('\"', '\"')
+            HANDLE_ESCAPE_SEQUENCE('\'', '\'')
+            HANDLE_ESCAPE_SEQUENCE('\\', '\\')
+
+            // Goofy
+            HANDLE_ESCAPE_SEQUENCE('a', '\a')
+            HANDLE_ESCAPE_SEQUENCE('b', '\b')
+            HANDLE_ESCAPE_SEQUENCE('e', '\e')
+            HANDLE_ESCAPE_SEQUENCE('f', '\f')
+
+            // Unknown escape sequences just drop the backslash
+            default:
+                unescaped += string[i];
+        }
     }
-    source_lines.push_back(source.substr(start));
+
+    return unescaped;
 }
 
-std::pair<std::vector<Token>, std::vector<LexException>> Lexer::lex() {
-    std::vector<Token> tokens;
-    std::vector<LexException> exceptions;
-    
+Lexer::Lexer(const SourceMap& source_map): source_map{source_map}, source{source_map.get_source()}, interner{&Interner::global()}, cursor{0}, limit{source.size()} {
+    // Token offsets are 32-bit
+    if (source.size() >= std::numeric_limits<uint32_t>::max()) {
+        throw std::length_error{"Source files larger than 4 GiB are not supported"};
+    }
+}
+
+Token Lexer::next() {
+    const CharScanners& scanners = get_char_scanners();
+
     while (true) {
         try { 
             // Skips whitespace
-            while (std::iswspace(peek()) || peek() == '\n') {
-                advance();
+            if (is_space(peek())) {
+                cursor = skip_char_class<CHAR_SPACE>(source, cursor + 1, scanners.skip_whitespace);
             }
 
-            if (peek() == '\0') {
-                tokens.push_back(Token{TokenType::EOF, cursor, cursor + 1});
-                break;
-            } else if (is_identifier_char(peek())) {
+            // The limit is only ever hit when lexing one chunk of the source in parallel
+            if (peek() == '\0' || cursor >= limit) {
+                // Stays at the end, so every further call returns EOF again
+                return make_token(TokenType::EOF, cursor, cursor + 1);
+            } else if (is_identifier_start(peek())) {
                 size_t start = cursor;
-                advance();
 
                 // [a-zA-z0-9_]
-                while (is_identifier_char(peek()) || std::iswdigit(peek())) {
-                    advance();
-                }
+                cursor = skip_char_class<CHAR_IDENTIFIER>(source, cursor + 1, scanners.skip_identifier);
 
-                std::string identifier = source.substr(start, cursor - start);
-                TokenType type;
+                std::string_view identifier = source.substr(start, cursor - start);
+                TokenType type = keyword_type(identifier);
 
-                if (is_keyword(identifier)) {
-                    if (identifier == "def") {
-                        type = TokenType::DEF;
-                    } else if (identifier == "let") {
-                        type = TokenType::LET;
-                    } else if (identifier == "__omg") {
-                        type = TokenType::__OMG;
-                    }
-                } else {
-                    type = TokenType::IDENTIFIER;
+                Token token = make_token(type, start, cursor);
+                if (type == TokenType::IDENTIFIER) {
+                    token.value.symbol = interner->intern(identifier);
                 }
-
-                tokens.push_back(make_token(type, start, cursor));
-            } else if (std::isdigit(peek())) {
+                return token;
+            } else if (is_digit(peek())) {
                 size_t start = cursor;
-                advance();
-                while (std::iswdigit(peek())) {
-                    advance();
-                }
+                cursor = skip_char_class<CHAR_DIGIT>(source, cursor + 1, scanners.skip_digits);
 
-                char suffix = peek();
-                std::string token_string = source.substr(start, cursor - start);
-                TokenType type;
+                const char* digits_beg = source.data() + start;
+                const char* digits_end = source.data() + cursor;
+                Token token{TokenType::INVALID, 0, 0};
 
-                switch (suffix) {
-                    case 'U' | 'u': // Unsigned
-                        try {
-                            type = TokenType::UINT64;
-                            advance();
-                        } catch (...) {
+                // Literals are decoded once, here; from_chars neither allocates nor depends on the locale
+                switch (peek()) {
+                    case 'U':
+                    case 'u': { // Unsigned
+                        uint64_t uint64 = 0;
+                        auto [ptr, errc] = std::from_chars(digits_beg, digits_end, uint64);
+                        advance();
+
+                        if (errc == std::errc::result_out_of_range) {
                             // L
-                            tokens.push_back(make_token(TokenType::INVALID, start, cursor));
-                            throw LexException{"Value " + token_string + " too large to store in an uint64", start, cursor};
+                            exceptions.push_back(LexException{"Value " + std::string{digits_beg, digits_end} + " too large to store in an uint64", start, cursor, source_map});
+                            return make_token(TokenType::INVALID, start, cursor);
                         }
+
+                        token = make_token(TokenType::UINT64, start, cursor);
+                        token.value.uint64 = uint64;
                         break;
+                    }
 
                     case '.': { // Floating point
-                        size_t decimal_start = cursor;
-                        advance();
-                        while (std::iswdigit(peek())) {
-                            advance();
-                        }
-                        std::string float_string = token_string + source.substr(decimal_start, cursor - decimal_start);
+                        cursor = skip_char_class<CHAR_DIGIT>(source, cursor + 1, scanners.skip_digits);
+                        digits_end = source.data() + cursor;
 
-                        try {
-                            type = TokenType::FLOAT64;
-                        } catch (...) {
-                            tokens.push_back(make_token(TokenType::INVALID, start, cursor));
-                            throw LexException{"Value " + float_string + " too large to store in an float64", start, cursor};
+                        double float64 = 0;
+                        auto [ptr, errc] = std::from_chars(digits_beg, digits_end, float64);
+
+                        if (errc == std::errc::result_out_of_range) {
+                            exceptions.push_back(LexException{"Value " + std::string{digits_beg, digits_end} + " too large to store in an float64", start, cursor, source_map});
+                            return make_token(TokenType::INVALID, start, cursor);
                         }
+
+                        token = make_token(TokenType::FLOAT64, start, cursor);
+                        token.value.float64 = float64;
                         break;
                     }
 
-                    default:
-                        try {
-                            type = TokenType::INT64;
-                        } catch (...) {
+                    default: {
+                        int64_t int64 = 0;
+                        auto [ptr, errc] = std::from_chars(digits_beg, digits_end, int64);
+
+                        if (errc == std::errc::result_out_of_range) {
                             // L
-                            tokens.push_back(make_token(TokenType::INVALID, start, cursor));
-                            throw LexException{"Value " + token_string + " too large to store in an int64", start, cursor};
+                            exceptions.push_back(LexException{"Value " + std::string{digits_beg, digits_end} + " too large to store in an int64", start, cursor, source_map});
+                            return make_token(TokenType::INVALID, start, cursor);
                         }
+
+                        token = make_token(TokenType::INT64, start, cursor);
+                        token.value.int64 = int64;
                         break;
+                    }
                 }
 
-                tokens.push_back(make_token(type, start, cursor));
-            } else if (peek() == U'"') {
-                std::string string;
+                return token;
+            } else if (peek() == '"') {
                 size_t start = cursor;
                 advance();
 
-                while (peek() != U'"') {
+                // Escapes are decoded lazily by unescape_string, here they only need to be skipped over
+                while (peek() != '"') {
                     if (peek() == '\0') {
-                        throw LexException{"Unterminated string", start, cursor};
+                        throw LexException{"Unterminated string", start, cursor, source_map};
                     }
 
-                    if (peek() == U'\\') {
+                    if (advance() == '\\' && peek() != '\0') {
                         advance();
-                        switch (peek()) {
-                            HANDLE_ESCAPE_SEQUENCE(U'n', U'\n')
-                            HANDLE_ESCAPE_SEQUENCE(U't', U'\t')
-                            HANDLE_ESCAPE_SEQUENCE(U'r', U'\r')
-                            HANDLE_ESCAPE_SEQUENCE(U'\"', U'\"')
-                            HANDLE_ESCAPE_SEQUENCE(U'\'', U'\'')
-                            HANDLE_ESCAPE_SEQUENCE(U'\\', U'\\')
-
-                            // Goofy
-                            HANDLE_ESCAPE_SEQUENCE(U'a', U'\a')
-                            HANDLE_ESCAPE_SEQUENCE(U'b', U'\b')
-                            HANDLE_ESCAPE_SEQUENCE(U'e', U'\e')
-                            HANDLE_ESCAPE_SEQUENCE(U'f', U'\f')
-                        }
-                    } else {
-                        string += advance();
                     }
                 }
                 advance();
 
-                Token token{TokenType::STRING, start, cursor};
-                token.text = std::move(string);
-                tokens.push_back(token);
+                return make_token(TokenType::STRING, start, cursor);
             } else {
                 switch (peek()) {
                     case '-':
                         advance();
                         if (peek() == '>') { // Arrow (->)
                             advance();
-                            tokens.push_back(make_token(TokenType::ARROW, cursor - 2, cursor));
-                        } else { // Subtraction
-                            tokens.push_back(make_token(TokenType::SUB, cursor - 1, cursor));
+                            return make_token(TokenType::ARROW, cursor - 2, cursor);
                         }
-                        break;
+                        // Subtraction
+                        return make_token(TokenType::SUB, cursor - 1, cursor);
 
                     case '/':
                         advance();
                         if (peek() == '/') { // Comment
-                            advance();
-                            while (peek() != '\0') {
-                                if (advance() == '\n') {
-                                    break;
-                                }
+                            cursor = scanners.skip_line(source, cursor + 1);
+                            if (peek() == '\n') {
+                                advance();
                             }
-                        } else { // Division
-                            tokens.push_back(make_token(TokenType::DIV, cursor - 1, cursor));
+                            break;
                         }
-                        break;
+                        // Division
+                        return make_token(TokenType::DIV, cursor - 1, cursor);
 
                     HANDLE_SIMPLE(TokenType::ADD, '+')
-                    HANDLE_SIMPLE(TokenType::MUL, '*')
-                    HANDLE_SIMPLE(TokenType::ASSIGN, '=')
+                    HANDLE_SIMPLE(TokenType::MOD, '%')
+                    HANDLE_COMPOUND(TokenType::MUL, TokenType::POW, '*', '*')
+
+                    HANDLE_SIMPLE(TokenType::BITWISE_AND, '&')
+                    HANDLE_SIMPLE(TokenType::BITWISE_OR, '|')
+                    HANDLE_SIMPLE(TokenType::BITWISE_NOT, '~')
+
+                    HANDLE_COMPOUND(TokenType::ASSIGN, TokenType::EQUAL, '=', '=')
+                    // A lone '!' isn't an operator (yet)
+                    HANDLE_COMPOUND(TokenType::INVALID, TokenType::NOT_EQUAL, '!', '=')
+                    HANDLE_COMPOUND(TokenType::LESS, TokenType::LESS_EQUAL, '<', '=')
+                    HANDLE_COMPOUND(TokenType::GREATER, TokenType::GREATER_EQUAL, '>', '=')
 
                     HANDLE_SIMPLE(TokenType::OPEN_PARENTHESES, '(')
                     HANDLE_SIMPLE(TokenType::CLOSE_PARENTHESES, ')')
@@ -217,52 +243,212 @@ std::pair<std::vector<Token>, std::vector<LexException>> Lexer::lex() {
                     HANDLE_SIMPLE(TokenType::SEMICOLON, ';')
 
                     default:
-                        tokens.push_back(make_token(TokenType::INVALID, cursor, cursor + 1));
                         advance();
+                        return make_token(TokenType::INVALID, cursor - 1, cursor);
                 }
             }
         } catch (LexException& exception) {
-            // Compute lines and columns based on index of src
-            size_t line = 1;
-            size_t column = 1;
-            for (size_t i = 0; i < exception.end; i++) {
-                if (source[i] == '\n') {
-                    column = 0;
-                    line++;
+            // Lines and columns are only resolved from the SourceMap once the exception is written
+            exceptions.push_back(exception);
+        }
+    }
+}
+
+std::pair<TokenStream, std::vector<LexException>> Lexer::lex() {
+    size_t chunk_count = 1;
+    if (source.size() >= parallel_lex_threshold) {
+        chunk_count = std::thread::hardware_concurrency();
+    }
+    return lex_chunked(chunk_count);
+}
+
+std::pair<TokenStream, std::vector<LexException>> Lexer::lex_chunked(size_t chunk_count) {
+    if (cursor == 0 && chunk_count > 1) {
+        std::vector<size_t> boundaries = find_chunk_boundaries(chunk_count);
+        if (boundaries.size() > 2) {
+            return lex_parallel(boundaries);
+        }
+    }
+
+    TokenStream tokens{source};
+
+    while (true) {
+        Token token = next();
+        tokens.push_back(token);
+        if (token.type == TokenType::EOF) {
+            break;
+        }
+    }
+
+    return std::make_pair(std::move(tokens), exceptions);
+}
+
+std::vector<size_t> Lexer::find_chunk_boundaries(size_t chunk_count) {
+    // Chunks may only be split right after a newline outside of a string, where the lexer is in its initial state:
+    // comments always end at the newline, but strings can span lines. The state is tracked with a cheap scan
+    enum class State {CODE, STRING, COMMENT} state = State::CODE;
+
+    const char* data = source.data();
+    const CharScanners& scanners = get_char_scanners();
+    std::vector<size_t> boundaries{0};
+    size_t next_target = source.size() / chunk_count;
+
+    for (size_t i = 0; i < source.size(); i++) {
+        switch (state) {
+            case State::CODE:
+                // Only quotes, slashes and NULs matter here, plus newlines once past the next target. strcspn stops at
+                // NULs by itself and is vectorized by libc
+                if (i + 1 < next_target) {
+                    i = std::min(i + std::strcspn(data + i, "\"/"), next_target - 1);
+                }
+                if (i + 1 >= next_target) {
+                    i += std::strcspn(data + i, "\"/\n");
+                }
+
+                if (data[i] == '"') {
+                    state = State::STRING;
+                } else if (data[i] == '/' && data[i + 1] == '/') {
+                    state = State::COMMENT;
+                    i++;
+                } else if (data[i] == '\0' && i < source.size()) {
+                    // The lexer stops at the first NUL, so the serial lexer has to handle this one
+                    return {0, source.size()};
+                } else if (data[i] == '\n' && i + 1 >= next_target) {
+                    boundaries.push_back(i + 1);
+                    next_target = i + 1 + source.size() / chunk_count;
+                }
+                break;
+            case State::STRING:
+                i += std::strcspn(data + i, "\"\\");
+                if (data[i] == '\\' && data[i + 1] != '\0') {
+                    i++;
+                } else if (data[i] == '"') {
+                    state = State::CODE;
+                } else if (data[i] == '\0' && i < source.size()) {
+                    return {0, source.size()};
+                }
+                break;
+            case State::COMMENT:
+                // Leaves the newline to be looked at in the CODE state
+                i = scanners.skip_line(source, i) - 1;
+                state = State::CODE;
+                break;
+        }
+    }
+
+    if (boundaries.back() != source.size()) {
+        boundaries.push_back(source.size());
+    }
+    return boundaries;
+}
+
+std::pair<TokenStream, std::vector<LexException>> Lexer::lex_parallel(const std::vector<size_t>& boundaries) {
+    size_t chunk_count = boundaries.size() - 1;
+    std::vector<Lexer> chunk_lexers(chunk_count, Lexer{source_map});
+    std::vector<TokenStream> chunk_tokens(chunk_count);
+    std::vector<std::unique_ptr<Interner>> chunk_interners(chunk_count);
+    std::vector<std::thread> workers;
+
+    for (size_t i = 0; i < chunk_count; i++) {
+        workers.emplace_back([&, i]() {
+            Lexer& chunk_lexer = chunk_lexers[i];
+            chunk_interners[i] = std::make_unique<Interner>();
+            chunk_lexer.interner = chunk_interners[i].get();
+            chunk_lexer.cursor = boundaries[i];
+            chunk_lexer.limit = boundaries[i + 1];
+
+            // Offsets are absolute since every chunk lexes the same buffer, so the chunks need no fixing up
+            chunk_tokens[i] = TokenStream{source};
+            while (true) {
+                Token token = chunk_lexer.next();
+                // Only the last chunk reaches the real end of the source
+                if (token.type == TokenType::EOF && i + 1 != chunk_count) {
+                    break;
+                }
+                chunk_tokens[i].push_back(token);
+                if (token.type == TokenType::EOF) {
+                    break;
                 }
-                column++;
             }
-            exception.source_line = source_lines[line - 1];
-            exception.line = line;
-            exception.column = column;
+        });
+    }
+
+    TokenStream tokens{source};
+    for (size_t i = 0; i < chunk_count; i++) {
+        workers[i].join();
+
+        // Merged in chunk order, the symbols come out the same as when lexing serially
+        std::vector<Symbol> symbols(chunk_interners[i]->size());
+        for (Symbol symbol = 0; symbol < symbols.size(); symbol++) {
+            symbols[symbol] = interner->intern(chunk_interners[i]->text(symbol));
+        }
+        chunk_tokens[i].remap_symbols(symbols);
 
+        tokens.splice(tokens.size(), tokens.size(), chunk_tokens[i], 0);
+        for (auto& exception: chunk_lexers[i].exceptions) {
             exceptions.push_back(exception);
         }
     }
+    cursor = source.size();
+
+    return std::make_pair(std::move(tokens), exceptions);
+}
+
+std::pair<TokenStream, std::vector<LexException>> Lexer::relex(TokenStream previous, const std::vector<LexException>& previous_exceptions, const SourceEdit& edit) {
+    int64_t delta = static_cast<int64_t>(edit.inserted_text.size()) - edit.removed_length;
+    size_t edit_end = edit.offset + edit.inserted_text.size();
+
+    // The lexer never looks more than one byte past a token, so tokens ending before the edit are untouched.
+    // Between two tokens it is always in its initial state, which makes the end of the last one a safe restart point
+    size_t first_relexed = previous.first_ending_after(edit.offset);
+    size_t restart = first_relexed == 0 ? 0 : previous[first_relexed - 1].end;
+
+    cursor = restart;
+    exceptions.clear();
 
-    size_t line = 1;
-    size_t column = 1;
-    size_t token_idx = 0;
-    size_t line_idx = 0;
-    for (size_t i = 0; i <= source.length(); i++) {
-        if (source[i] == '\n') {
-            column = 0;
-            line++;
-            line_idx = i + 1;
+    TokenStream relexed{source};
+    size_t resync_idx = previous.size();
+    while (true) {
+        Token token = next();
+
+        // The lexer has no state besides the cursor, so once a token starts past the edit exactly where an old
+        // token started, everything from there on is the old stream moved by delta. Exceptions from there on are
+        // the old ones too, even when next() reported them on the way to this token
+        if (token.beg >= edit_end) {
+            resync_idx = previous.find_beg(static_cast<uint32_t>(token.beg - delta), first_relexed);
+            if (resync_idx != previous.size()) {
+                while (!exceptions.empty() && exceptions.back().start >= token.beg) {
+                    exceptions.pop_back();
+                }
+                break;
+            }
         }
-        
-        if (tokens[token_idx].beg == i) {
-            tokens[token_idx].line = line;
-            tokens[token_idx].column = column - 1;
-
-            tokens[token_idx].line_beg = i - line_idx;
-            tokens[token_idx].line_end = tokens[token_idx].end - line_idx;
-            // std::cout << stringify(tokens[token_idx].type) << " line: " << line << " column: " << column << '\n';
-            token_idx++;
+
+        relexed.push_back(token);
+        if (token.type == TokenType::EOF) {
+            break;
         }
+    }
 
-        column++;
+    uint32_t resync_beg = resync_idx == previous.size() ? std::numeric_limits<uint32_t>::max() : previous.beg(resync_idx);
+
+    previous.splice(first_relexed, resync_idx, relexed, delta);
+    previous.set_source(source);
+
+    std::vector<LexException> new_exceptions;
+    for (auto& exception: previous_exceptions) {
+        if (exception.end <= restart) {
+            new_exceptions.push_back(LexException{exception.exception_message, exception.start, exception.end, source_map});
+        }
+    }
+    for (auto& exception: exceptions) {
+        new_exceptions.push_back(exception);
+    }
+    for (auto& exception: previous_exceptions) {
+        if (exception.start >= resync_beg) {
+            new_exceptions.push_back(LexException{exception.exception_message, exception.start + delta, exception.end + delta, source_map});
+        }
     }
 
-    return std::make_pair(tokens, exceptions);
+    return std::make_pair(std::move(previous), new_exceptions);
 }
@@ -1,22 +1,22 @@
 #include "chung/library/prelude.hpp"
 
-extern "C" {
-    #include <cstdio>
-    #include <cinttypes>
-
-    void print(int64_t int64) {
-        printf("%" PRId64 "\n", int64);
-    }
-}
-
 void setup_prelude(Context& ctx) {
     // print
     std::vector<llvm::Type*> print_params{llvm::Type::getInt64Ty(ctx.context)};
     llvm::Type* print_return_type = llvm::Type::getVoidTy(ctx.context);
     llvm::FunctionType* print_func_type = llvm::FunctionType::get(print_return_type, print_params, false);
     llvm::Function* print_func = llvm::Function::Create(print_func_type, llvm::Function::ExternalLinkage, "print", ctx.module.get());
+    ctx.functions.set(Interner::global().intern("print"), print_func);
     
     for (auto& arg: print_func->args()) {
         arg.setName("value");
     }
+}
+
+llvm::ArrayRef<PreludeSymbol> prelude_symbols() {
+    // Keep in sync with setup_prelude
+    static const PreludeSymbol symbols[] = {
+        {"print", reinterpret_cast<void*>(&print)}
+    };
+    return symbols;
 }
\ No newline at end of file
@@ -0,0 +1,10 @@
+#include <cstdio>
+#include <cinttypes>
+
+#include "chung/library/runtime.hpp"
+
+extern "C" {
+    void print(int64_t int64) {
+        printf("%" PRId64 "\n", int64);
+    }
+}
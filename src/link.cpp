@@ -0,0 +1,47 @@
+#include "lld/Common/CommonLinkerContext.h"
+#include "lld/Common/Driver.h"
+
+#include "chung/link.hpp"
+
+// Where scripts/build_prelude.sh puts it by default. Absolute, so `chung parse` links from any directory
+#ifndef CHUNG_PRELUDE_ARCHIVE
+#define CHUNG_PRELUDE_ARCHIVE "/usr/local/lib/libchung_prelude.a"
+#endif
+
+#ifndef CHUNG_CRT_DIR
+#define CHUNG_CRT_DIR "/usr/lib/x86_64-linux-gnu"
+#endif
+
+#ifndef CHUNG_DYNAMIC_LINKER
+#define CHUNG_DYNAMIC_LINKER "/lib64/ld-linux-x86-64.so.2"
+#endif
+
+LLD_HAS_DRIVER(elf)
+
+bool link_executable(const std::vector<std::string>& objects, const std::string& output_path, llvm::raw_ostream& errors) {
+    // What a compiler driver would hand ld.lld for a dynamically linked C program. The name picks the GNU flavor
+    std::vector<const char*> args{
+        "ld.lld",
+        "--eh-frame-hdr",
+        "-dynamic-linker", CHUNG_DYNAMIC_LINKER,
+        "-o", output_path.c_str(),
+        CHUNG_CRT_DIR "/crt1.o",
+        CHUNG_CRT_DIR "/crti.o"
+    };
+    for (const std::string& object: objects) {
+        args.push_back(object.c_str());
+    }
+    args.insert(args.end(), {
+        CHUNG_PRELUDE_ARCHIVE,
+        "-L" CHUNG_CRT_DIR,
+        "-lc",
+        CHUNG_CRT_DIR "/crtn.o"
+    });
+
+    // Nothing on success, LLD only talks when something is wrong. Without exitEarly set to false, LLD exits the whole
+    // process once it's done, and a failed link would never make it back here
+    bool linked = lld::elf::link(args, llvm::nulls(), errors, /*exitEarly=*/false, /*disableOutput=*/false);
+    // LLD keeps its state in a global context, which has to go before the next link
+    lld::CommonLinkerContext::destroy();
+    return linked;
+}
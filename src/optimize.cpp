@@ -0,0 +1,94 @@
+#include <optional>
+
+#include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/LoopAnalysisManager.h"
+#include "llvm/IR/PassInstrumentation.h"
+#include "llvm/IR/PassManager.h"
+#include "llvm/IR/PassTimingInfo.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Passes/PassBuilder.h"
+
+#include "chung/optimize.hpp"
+
+bool parse_opt_level(const std::string& flag, OptLevel& level) {
+    if (flag == "-O0") {
+        level = OptLevel::O0;
+    } else if (flag == "-O1") {
+        level = OptLevel::O1;
+    } else if (flag == "-O2") {
+        level = OptLevel::O2;
+    } else if (flag == "-O3") {
+        level = OptLevel::O3;
+    } else if (flag == "-Os") {
+        level = OptLevel::Os;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+llvm::CodeGenOpt::Level codegen_opt_level(OptLevel level) {
+    switch (level) {
+        case OptLevel::O0:
+            return llvm::CodeGenOpt::None;
+        case OptLevel::O1:
+            return llvm::CodeGenOpt::Less;
+        case OptLevel::O3:
+            return llvm::CodeGenOpt::Aggressive;
+        default:
+            return llvm::CodeGenOpt::Default;
+    }
+}
+
+static llvm::OptimizationLevel pipeline_level(OptLevel level) {
+    switch (level) {
+        case OptLevel::O0:
+            return llvm::OptimizationLevel::O0;
+        case OptLevel::O1:
+            return llvm::OptimizationLevel::O1;
+        case OptLevel::O3:
+            return llvm::OptimizationLevel::O3;
+        case OptLevel::Os:
+            return llvm::OptimizationLevel::Os;
+        default:
+            return llvm::OptimizationLevel::O2;
+    }
+}
+
+void optimize_module(llvm::Module& module, llvm::TargetMachine* target_machine, OptLevel level, bool time_passes) {
+    // The backend only sizes code down for functions asking for it, like clang does at -Os
+    if (level == OptLevel::Os) {
+        for (llvm::Function& function: module) {
+            if (!function.isDeclaration()) {
+                function.addFnAttr(llvm::Attribute::OptimizeForSize);
+            }
+        }
+    }
+
+    llvm::PassInstrumentationCallbacks callbacks;
+    llvm::TimePassesHandler pass_timer{time_passes};
+    pass_timer.registerCallbacks(callbacks);
+
+    llvm::LoopAnalysisManager loop_analyses;
+    llvm::FunctionAnalysisManager function_analyses;
+    llvm::CGSCCAnalysisManager cgscc_analyses;
+    llvm::ModuleAnalysisManager module_analyses;
+
+    llvm::PassBuilder pass_builder{target_machine, llvm::PipelineTuningOptions{}, std::nullopt, &callbacks};
+    pass_builder.registerModuleAnalyses(module_analyses);
+    pass_builder.registerCGSCCAnalyses(cgscc_analyses);
+    pass_builder.registerFunctionAnalyses(function_analyses);
+    pass_builder.registerLoopAnalyses(loop_analyses);
+    pass_builder.crossRegisterProxies(loop_analyses, function_analyses, cgscc_analyses, module_analyses);
+
+    llvm::OptimizationLevel optimization_level = pipeline_level(level);
+    llvm::ModulePassManager passes = level == OptLevel::O0 ?
+        pass_builder.buildO0DefaultPipeline(optimization_level) :
+        pass_builder.buildPerModuleDefaultPipeline(optimization_level);
+    passes.run(module, module_analyses);
+
+    // Reports now rather than whenever the handler goes away
+    if (time_passes) {
+        pass_timer.print();
+    }
+}
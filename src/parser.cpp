@@ -1,92 +1,180 @@
+#include <algorithm>
+#include <array>
+#include <functional>
 #include <memory>
+#include <thread>
 #include <vector>
-#include <unordered_map>
 
+#include "chung/lexer.hpp"
 #include "chung/parser.hpp"
 #include "chung/stringify.hpp"
 
-#define MATCH_NO_SYNC(condition, exception_string)                   \
-    if (!(current_token().condition)) {                              \
-        push_exception(exception_string, current_token());           \
-    }                                                                \
-    eat_token();                                                     \
-
+#define MATCH_NO_SYNC(condition, exception_string)                                        \
+    if (!(current_token().condition)) {                                                   \
+        const Token& token_ = current_token();                                            \
+        exceptions.emplace_back(exception_string, token_.beg, token_.end, source_map);    \
+    }                                                                                     \
+    eat_token();                                                                          \
+
+
+// Binding powers, loosest first
+enum BindingPower: uint8_t {
+    POWER_NONE = 0,
+    POWER_ASSIGNMENT = 10,
+    POWER_EQUALITY = 20,
+    POWER_COMPARISON = 30,
+    POWER_BITWISE_OR = 40,
+    POWER_BITWISE_AND = 50,
+    POWER_TERM = 60,
+    POWER_FACTOR = 70,
+    POWER_UNARY = 80,
+    POWER_EXPONENT = 90
+};
+
+constexpr std::array<ParseRule, token_type_count> make_parse_rules() {
+    std::array<ParseRule, token_type_count> rules{};
+
+    // Whatever can't start an expression is reported by parse_primitive, except symbols, which just end it
+    for (size_t type = 0; type < token_type_count; type++) {
+        rules[type] = ParseRule{is_symbol(static_cast<TokenType>(type)) ? nullptr : &Parser::parse_primitive, nullptr, POWER_NONE, Associativity::LEFT};
+    }
 
-int get_op_precedence(TokenType op) {
-    static const std::unordered_map<TokenType, int> op_lookup {
-        {TokenType::ADD, 1}, {TokenType::SUB, 1},
-        {TokenType::MUL, 2}, {TokenType::DIV, 2}, {TokenType::MOD, 2},
-        {TokenType::POW, 3}
+    auto prefix = [&rules](TokenType type, ParseRule::PrefixHandler handler) {
+        rules[static_cast<size_t>(type)].prefix = handler;
+    };
+    auto infix = [&rules](TokenType type, uint8_t power, Associativity associativity, ParseRule::InfixHandler handler) {
+        ParseRule& rule = rules[static_cast<size_t>(type)];
+        rule.infix = handler;
+        rule.power = power;
+        rule.associativity = associativity;
     };
 
-    auto result = op_lookup.find(op);
-    if (result == op_lookup.end()) {
-        return -1;
-    }
-    return result->second;
+    prefix(TokenType::IDENTIFIER, &Parser::parse_identifier);
+    prefix(TokenType::OPEN_PARENTHESES, &Parser::parse_parentheses);
+    prefix(TokenType::ADD, &Parser::parse_unary);
+    prefix(TokenType::SUB, &Parser::parse_unary);
+    prefix(TokenType::BITWISE_NOT, &Parser::parse_unary);
+
+    infix(TokenType::ASSIGN, POWER_ASSIGNMENT, Associativity::RIGHT, &Parser::parse_assignment);
+
+    infix(TokenType::EQUAL, POWER_EQUALITY, Associativity::LEFT, &Parser::parse_binary);
+    infix(TokenType::NOT_EQUAL, POWER_EQUALITY, Associativity::LEFT, &Parser::parse_binary);
+    infix(TokenType::LESS, POWER_COMPARISON, Associativity::LEFT, &Parser::parse_binary);
+    infix(TokenType::LESS_EQUAL, POWER_COMPARISON, Associativity::LEFT, &Parser::parse_binary);
+    infix(TokenType::GREATER, POWER_COMPARISON, Associativity::LEFT, &Parser::parse_binary);
+    infix(TokenType::GREATER_EQUAL, POWER_COMPARISON, Associativity::LEFT, &Parser::parse_binary);
+
+    infix(TokenType::BITWISE_OR, POWER_BITWISE_OR, Associativity::LEFT, &Parser::parse_binary);
+    infix(TokenType::BITWISE_AND, POWER_BITWISE_AND, Associativity::LEFT, &Parser::parse_binary);
+
+    infix(TokenType::ADD, POWER_TERM, Associativity::LEFT, &Parser::parse_binary);
+    infix(TokenType::SUB, POWER_TERM, Associativity::LEFT, &Parser::parse_binary);
+    infix(TokenType::MUL, POWER_FACTOR, Associativity::LEFT, &Parser::parse_binary);
+    infix(TokenType::DIV, POWER_FACTOR, Associativity::LEFT, &Parser::parse_binary);
+    infix(TokenType::MOD, POWER_FACTOR, Associativity::LEFT, &Parser::parse_binary);
+
+    // Binds tighter than unary minus: -2 ** 2 is -(2 ** 2)
+    infix(TokenType::POW, POWER_EXPONENT, Associativity::RIGHT, &Parser::parse_binary);
+
+    return rules;
 }
 
+static constexpr std::array<ParseRule, token_type_count> parse_rules = make_parse_rules();
 
-ParseException::ParseException(const std::string& exception_message, const Token& token, const std::string& source_line):
-    exception_message{exception_message}, token{token}, source_line{source_line} {}
+inline const ParseRule& get_parse_rule(TokenType type) {
+    return parse_rules[static_cast<size_t>(type)];
+}
+
+
+ParseException::ParseException(const char* exception_message, uint32_t beg, uint32_t end, const SourceMap& source_map):
+    exception_message{exception_message}, beg{beg}, end{end}, source_map{source_map} {}
 
-std::string ParseException::write() {
-    std::string string{"ParseException at line " + std::to_string(token.line) + " column " + std::to_string(token.column) + ":\n"};
+std::string ParseException::write() const {
+    uint32_t line = source_map.line(beg);
+    uint32_t column = source_map.column(beg);
+    std::string_view source_line = source_map.line_text(line);
+
+    std::string string{"ParseException at line " + std::to_string(line) + " column " + std::to_string(column) + ":\n"};
     std::string carets;
 
+    size_t line_beg = column;
+    size_t line_end = column + (end - beg);
     for (size_t i = 0; i <= source_line.length(); i++) {
-        if (token.line_beg <= i && i < token.line_end) {
+        if (line_beg <= i && i < line_end) {
             carets += '^';
         } else {
             carets += '~';
         }
     }
 
-    string += '\t' + source_line + '\n';
+    string += '\t' + std::string{source_line} + '\n';
     string += '\t' + carets + '\n';
-    string += exception_message + '\n';
+    string += exception_message;
+    string += '\n';
     
     return string;
 }
 
 
-Parser::Parser(const std::vector<Token> tokens, const std::vector<std::string> source_lines, Context& ctx):
-    tokens{std::move(tokens)}, source_lines{std::move(source_lines)}, ctx{ctx}, tokens_idx{0} {}
+Parser::Parser(TokenStream tokens, const SourceMap& source_map, Context& ctx, AstArena& arena):
+    tokens{std::move(tokens)}, stream{&this->tokens}, stream_idx{0}, stream_end{this->tokens.size()}, lexer{nullptr}, tokens_pulled{0}, source_map{source_map}, ctx{ctx}, arena{arena}, panicking{false}, block_depth{0}, orphan_braces{0}, block_orphans{0}, tokens_idx{0} {}
+
+Parser::Parser(Lexer& lexer, const SourceMap& source_map, Context& ctx, AstArena& arena):
+    tokens{}, stream{&tokens}, stream_idx{0}, stream_end{0}, lexer{&lexer}, tokens_pulled{0}, source_map{source_map}, ctx{ctx}, arena{arena}, panicking{false}, block_depth{0}, orphan_braces{0}, block_orphans{0}, tokens_idx{0} {}
+
+Parser::Parser(const TokenStream* stream, const SourceMap& source_map, Context& ctx, AstArena& arena):
+    tokens{}, stream{stream}, stream_idx{0}, stream_end{0}, lexer{nullptr}, tokens_pulled{0}, source_map{source_map}, ctx{ctx}, arena{arena}, panicking{false}, block_depth{0}, orphan_braces{0}, block_orphans{0}, tokens_idx{0} {}
 
 void Parser::synchronize() {
-    eat_token();
+    panicking = false;
 
-    while (current_token().type != TokenType::EOF) {
-        Token prev = previous_token();
-        if (prev.type == TokenType::SEMICOLON) {
-            // std::cout << "Done synchronizing\n";
-            // std::cout << stringify(next_token());
-            return;
-        } else {
-            Token next = next_token();
-            if (next.type == TokenType::LET) {
-                // std::cout << "Done synchronizing\n";
+    while (true) {
+        switch (current_token().type) {
+            case TokenType::EOF:
                 return;
-            }
+            case TokenType::SEMICOLON:
+                eat_token();
+                return;
+            case TokenType::OPEN_BRACES:
+                // The block goes on being parsed as an orphan
+                eat_token();
+                orphan_braces++;
+                return;
+            case TokenType::CLOSE_BRACES:
+                if (orphan_braces > block_orphans) {
+                    orphan_braces--;
+                } else if (block_depth > 0) {
+                    // Closes the block being parsed, parse_block takes it from here
+                    return;
+                }
+                eat_token();
+                return;
+            case TokenType::DEF:
+            case TokenType::LET:
+                return;
+            default:
+                eat_token();
+                break;
         }
-
-        eat_token();
     }
 }
 
-std::shared_ptr<ExprAST> Parser::parse_call() {
+ExprAST* Parser::parse_call() {
     // Eat function callee
     Token callee = eat_token();
 
     // Eats '('
-    match_simple(TokenType::OPEN_PARENTHESES, "Expected '(' after function callee");
-    std::vector<std::shared_ptr<ExprAST>> arguments;
+    if (!match_simple(TokenType::OPEN_PARENTHESES, "Expected '(' after function callee")) {
+        return nullptr;
+    }
+    size_t first_argument = children.size();
 
     bool running = true;
     while (running) {
         if (auto argument = parse_expression()) {
-            arguments.push_back(argument);
+            children.push_back(argument);
         } else {
+            children.resize(first_argument);
             return nullptr;
         }
 
@@ -98,139 +186,138 @@ std::shared_ptr<ExprAST> Parser::parse_call() {
                 eat_token();
                 break;
             default:
-                throw push_exception("Expected ',' or ')' within function call", current_token());
+                return fail("Expected ',' or ')' within function call", current_token());
         }
     }
 
     // Eat ')'
     eat_token();
-    return std::make_shared<CallAST>(callee.text, std::move(arguments));
+    ArenaSpan<ExprAST*> arguments = pop_children<ExprAST>(first_argument);
+    return arena.make<CallAST>(callee.value.symbol, arguments);
 }
 
-std::shared_ptr<ExprAST> Parser::parse_identifier() {
-    Token token = current_token();
-    Token next = next_token();
+ExprAST* Parser::parse_identifier() {
+    const Token& token = current_token();
+    const Token& next = next_token();
 
     if (next.type != TokenType::OPEN_PARENTHESES) {
         // Eat identifier
         eat_token();
-        return std::make_shared<VariableAST>(token.text);
+        return arena.make<VariableAST>(token.value.symbol);
     }
 
     // A call
     return parse_call();
 }
 
-std::shared_ptr<ExprAST> Parser::parse_parentheses() {
+ExprAST* Parser::parse_parentheses() {
     // Eat '('
     eat_token();
-    std::shared_ptr<ExprAST> expr = parse_expression();
+    ExprAST* expr = parse_expression();
     if (!expr) {
         return nullptr;
     }
 
     // Eat ')'
-    match_simple(TokenType::CLOSE_PARENTHESES, "Expected closing parenthesis ')'");
+    if (!match_simple(TokenType::CLOSE_PARENTHESES, "Expected closing parenthesis ')'")) {
+        return nullptr;
+    }
     return expr;
 }
 
-std::shared_ptr<ExprAST> Parser::parse_bin_op(int min_op_precedence, std::shared_ptr<ExprAST> lhs) {
-    while (true) {
-        Token op = current_token();
-        int op_precedence = get_op_precedence(op.type);
+ExprAST* Parser::parse_primitive() {
+    const Token& token = eat_token();
 
-        if (op_precedence < min_op_precedence || !is_operator(op.type)) {
-            return lhs;
+    switch (token.type) {
+        case TokenType::INT64:
+            return arena.make<PrimitiveAST>(token.value.int64);
+        case TokenType::UINT64:
+            return arena.make<PrimitiveAST>(token.value.uint64);
+        case TokenType::FLOAT64:
+            return arena.make<PrimitiveAST>(token.value.float64);
+        case TokenType::STRING: {
+            return arena.make<PrimitiveAST>(arena.copy_string(unescape_string(token.text)));
         }
-        // std::cout << "Binary op: " << stringify(op.value.op) << '\n';
-
-        // Eat operator
-        eat_token();
-        std::shared_ptr<ExprAST> rhs = parse_primary();
+        default:
+            // Invalid token
+            return fail("Invalid token in expression", token);
+    }
+}
 
-        int next_op_precedence = get_op_precedence(current_token().type);
-        if (op_precedence < next_op_precedence) {
-            rhs = parse_bin_op(min_op_precedence + 1, std::move(rhs));
-        }
+ExprAST* Parser::parse_unary() {
+    Token op = eat_token();
 
-        lhs = std::make_shared<BinaryExprAST>(op.type, std::move(lhs), std::move(rhs));
+    ExprAST* operand = parse_expression(POWER_UNARY);
+    if (!operand) {
+        return panicking ? nullptr : fail("Expected expression after unary operator", current_token());
     }
-}
 
-std::shared_ptr<ExprAST> Parser::parse_primitive() {
-    Token token = eat_token();
+    return arena.make<UnaryExprAST>(op.type, operand);
+}
 
-    switch (token.type) {
-        case TokenType::INT64: {
-            int64_t int64 = std::stoll(token.text);
-            return std::make_shared<PrimitiveAST>(int64);
-        }
-        case TokenType::UINT64: {
-            uint64_t uint64 = std::stoull(token.text);
-            return std::make_shared<PrimitiveAST>(uint64);
-        }
-        case TokenType::FLOAT64: {
-            double float64 = std::stod(token.text);
-            return std::make_shared<PrimitiveAST>(float64);
-        }
-        case TokenType::STRING: {
-            return std::make_shared<PrimitiveAST>(token.text);
-        }
-        default:
-            // Invalid token
-            throw push_exception("Invalid token in expression", token);
+ExprAST* Parser::parse_binary(ExprAST* lhs, const Token& op, int right_power) {
+    ExprAST* rhs = parse_expression(right_power);
+    if (!rhs) {
+        return panicking ? nullptr : fail("Expected expression after operator", current_token());
     }
+
+    return arena.make<BinaryExprAST>(op.type, lhs, rhs);
 }
 
-std::shared_ptr<ExprAST> Parser::parse_primary() {
-    Token token = current_token();
-    if (token.type == TokenType::IDENTIFIER) {
-        return parse_identifier();
-    } else if (is_symbol(token.type)) {
-        if (token.type == TokenType::OPEN_PARENTHESES) {
-            return parse_parentheses();
-        }
-        return nullptr;
-    } else {
-        // std::cout << "Primitive\n";
-        return parse_primitive();
+ExprAST* Parser::parse_assignment(ExprAST* lhs, const Token& op, int right_power) {
+    if (!dynamic_cast<VariableAST*>(lhs)) {
+        return fail("Can only assign to a variable", op);
     }
+
+    return parse_binary(lhs, op, right_power);
 }
 
-std::vector<std::shared_ptr<StmtAST>> Parser::parse_block() {
+ArenaSpan<StmtAST*> Parser::parse_block() {
     // Eat '{'
-    match_simple(TokenType::OPEN_BRACES, "Expected '{' at start of block");
+    if (!match_simple(TokenType::OPEN_BRACES, "Expected '{' at start of block")) {
+        return {};
+    }
+
+    // Statements failing in here recover on their own, up to the closing '}' at worst
+    block_depth++;
+    size_t outer_block_orphans = block_orphans;
+    block_orphans = orphan_braces;
 
-    std::vector<std::shared_ptr<StmtAST>> statements;
-    while (current_token().type != TokenType::CLOSE_BRACES) {
+    size_t first_statement = children.size();
+    while (current_token().type != TokenType::CLOSE_BRACES || orphan_braces > block_orphans) {
         if (current_token().type == TokenType::EOF) {
-            throw push_exception("Expected '}', got EOF. You probably forgot to close the block", current_token());
+            block_depth--;
+            block_orphans = outer_block_orphans;
+            fail("Expected '}', got EOF. You probably forgot to close the block", current_token());
+            return {};
         }
 
         // std::cout << "OOW" << stringify(current_token());
-        statements.push_back(parse_statement());
+        children.push_back(parse_statement());
         // std::cout << "WOW" << stringify(current_token());
     }
+    block_depth--;
+    block_orphans = outer_block_orphans;
 
     // Eat '}'
     // std::cout << 'O' << stringify(eat_token());
     eat_token();
 
-    return statements;
+    return pop_children<StmtAST>(first_statement);
 }
 
-std::shared_ptr<StmtAST> Parser::parse_var_declaration() {
+StmtAST* Parser::parse_var_declaration() {
     // Eat 'let'
     eat_token();
 
     // Eat identifier
     Token identifier = current_token();
     if (identifier.type != TokenType::IDENTIFIER) {
-        throw push_exception("Expected identifier to assign expression to", identifier);
+        return fail("Expected identifier to assign expression to", identifier);
     }
     eat_token();
     
-    std::shared_ptr<ExprAST> expr = std::make_shared<PrimitiveAST>();
+    ExprAST* expr = arena.make<PrimitiveAST>();
     if (current_token().type == TokenType::ASSIGN) {
         // Eat '='
         eat_token();
@@ -241,42 +328,54 @@ std::shared_ptr<StmtAST> Parser::parse_var_declaration() {
         return nullptr;
     }
 
-    match_simple(TokenType::SEMICOLON, "Expected ';' after identifier");
+    if (!match_simple(TokenType::SEMICOLON, "Expected ';' after identifier")) {
+        return nullptr;
+    }
 
     // FOR NOW
-    return std::make_shared<VarDeclareAST>(identifier.text, Type::tnone, std::move(expr));
+    return arena.make<VarDeclareAST>(identifier.value.symbol, Type::tnone, expr);
 }
 
-std::shared_ptr<StmtAST> Parser::parse_function() {
+StmtAST* Parser::parse_function() {
     // Eat 'def'
     eat_token();
 
     // Get and eat function name
     Token name = current_token();
-    match_simple(TokenType::IDENTIFIER, "Expected function name after 'def'");
+    if (!match_simple(TokenType::IDENTIFIER, "Expected function name after 'def'")) {
+        return nullptr;
+    }
 
     // Eat '('
-    match_simple(TokenType::OPEN_PARENTHESES, "Expected '(' after function declaration");
+    if (!match_simple(TokenType::OPEN_PARENTHESES, "Expected '(' after function declaration")) {
+        return nullptr;
+    }
 
-    std::vector<VarDeclareAST> parameters;
+    size_t first_parameter = children.size();
     while (current_token().type != TokenType::CLOSE_PARENTHESES) {
         // Get and eat parameter name
         Token parameter = current_token();
-        match_simple(TokenType::IDENTIFIER, "Expected parameter name in function declaration");
+        if (!match_simple(TokenType::IDENTIFIER, "Expected parameter name in function declaration")) {
+            return nullptr;
+        }
 
         // Eat ':'
-        match_simple(TokenType::COLON, "Expected ':' after parameter name to specify parameter type");
+        if (!match_simple(TokenType::COLON, "Expected ':' after parameter name to specify parameter type")) {
+            return nullptr;
+        }
 
         Token type_name = current_token();
-        match_simple(TokenType::IDENTIFIER, "Expected type in parameter declaration");
+        if (!match_simple(TokenType::IDENTIFIER, "Expected type in parameter declaration")) {
+            return nullptr;
+        }
         
-        Type& type = ctx.get_type(type_name.text);
+        Type& type = ctx.get_type(type_name.value.symbol);
         if (type.ty == Ty::TINVALID) {
-            throw push_exception("Type does not exist", type_name);
+            return fail("Type does not exist", type_name);
         }
 
         // No default values FOR NOW
-        parameters.push_back(VarDeclareAST{parameter.text, type, nullptr});
+        children.push_back(arena.make<VarDeclareAST>(parameter.value.symbol, type, nullptr));
 
         switch (current_token().type) {
             case TokenType::COMMA:
@@ -284,86 +383,246 @@ std::shared_ptr<StmtAST> Parser::parse_function() {
             case TokenType::CLOSE_PARENTHESES:
                 break;
             default:
-                throw push_exception("Expected either '(' or ',' in function parameter list", current_token());
+                return fail("Expected either '(' or ',' in function parameter list", current_token());
         }
     }
 
     // Eat ')'
-    match_simple(TokenType::CLOSE_PARENTHESES, "Expected ')' after parameter list");
+    if (!match_simple(TokenType::CLOSE_PARENTHESES, "Expected ')' after parameter list")) {
+        return nullptr;
+    }
 
-    std::vector<std::shared_ptr<StmtAST>> body = parse_block();
-    return std::make_shared<FunctionAST>(name.text, parameters, body);
+    ArenaSpan<VarDeclareAST*> parameters = pop_children<VarDeclareAST>(first_parameter);
+    ArenaSpan<StmtAST*> body = parse_block();
+    if (panicking) {
+        return nullptr;
+    }
+    return arena.make<FunctionAST>(name.value.symbol, parameters, body);
 }
 
-std::shared_ptr<StmtAST> Parser::parse_omg() {
+StmtAST* Parser::parse_omg() {
     // Eat '__omg'
     eat_token();
 
-    std::shared_ptr<ExprAST> expr = parse_expression();
+    ExprAST* expr = parse_expression();
     if (!expr) {
         return nullptr;
     }
 
     // Eat ';'
-    match_simple(TokenType::SEMICOLON, "Expected ';' after value");
+    if (!match_simple(TokenType::SEMICOLON, "Expected ';' after value")) {
+        return nullptr;
+    }
 
-    return std::make_shared<OmgAST>(expr);
+    return arena.make<OmgAST>(expr);
 }
 
-std::shared_ptr<ExprAST> Parser::parse_expression() {
-    std::shared_ptr<ExprAST> lhs = parse_primary();
-    if (lhs == nullptr) {
+ExprAST* Parser::parse_expression(int min_power) {
+    const ParseRule& prefix_rule = get_parse_rule(current_token().type);
+    if (!prefix_rule.prefix) {
         return nullptr;
     }
 
-    return parse_bin_op(0, std::move(lhs));
+    ExprAST* lhs = (this->*prefix_rule.prefix)();
+    if (!lhs) {
+        return nullptr;
+    }
+
+    while (true) {
+        // Tokens that aren't infix operators have no power, so they always end the expression
+        const ParseRule& rule = get_parse_rule(current_token().type);
+        if (rule.power <= min_power) {
+            return lhs;
+        }
+
+        // Left-associative operators stop at an operator of their own power, right-associative ones take it in
+        int right_power = rule.associativity == Associativity::LEFT ? rule.power : rule.power - 1;
+        Token op = eat_token();
+        lhs = (this->*rule.infix)(lhs, op, right_power);
+        if (!lhs) {
+            return nullptr;
+        }
+    }
 }
 
-std::shared_ptr<StmtAST> Parser::parse_expression_statement() {
-    std::shared_ptr<ExprAST> expr = parse_expression();
+StmtAST* Parser::parse_expression_statement() {
+    ExprAST* expr = parse_expression();
+    if (panicking) {
+        return nullptr;
+    }
 
     // Eat ';'
-    match_simple(TokenType::SEMICOLON, "Expected ';' after expression");
+    if (!match_simple(TokenType::SEMICOLON, "Expected ';' after expression")) {
+        return nullptr;
+    }
 
     if (!expr) {
         return nullptr;
     }
 
-    return std::make_shared<ExprStmtAST>(expr);
+    return arena.make<ExprStmtAST>(expr);
 }
 
-std::shared_ptr<StmtAST> Parser::parse_statement() {
-    try {
-        Token token = current_token();
-        if (is_keyword(token.type)) {
-            switch (token.type) {
-                case TokenType::LET: return parse_var_declaration();
-                case TokenType::DEF: return parse_function();
-                case TokenType::__OMG: return parse_omg();
-                default: {
-                    std::cout << "You failed me.\n";
-                    return nullptr;
-                }
+StmtAST* Parser::parse_statement() {
+    // Whatever a failed statement left on the scratch stack is dropped with it
+    size_t children_size = children.size();
+
+    const Token& token = current_token();
+    if (token.type == TokenType::CLOSE_BRACES && orphan_braces > block_orphans) {
+        eat_token();
+        orphan_braces--;
+        return nullptr;
+    }
+
+    bool orphaned = orphan_braces > 0;
+    StmtAST* statement = nullptr;
+    if (is_keyword(token.type)) {
+        switch (token.type) {
+            case TokenType::LET: statement = parse_var_declaration(); break;
+            case TokenType::DEF: statement = parse_function(); break;
+            case TokenType::__OMG: statement = parse_omg(); break;
+            default: {
+                std::cout << "You failed me.\n";
+                return nullptr;
             }
-        } else {
-            return parse_expression_statement();
         }
-    } catch (ParseException& exception) {
+    } else {
+        statement = parse_expression_statement();
+    }
+
+    if (panicking) {
+        children.resize(children_size);
         synchronize();
-        // std::cout << exception.write() << '\n';
         return nullptr;
     }
+    return orphaned ? nullptr : statement;
+}
+
+std::vector<StmtAST*> Parser::parse() {
+    std::vector<StmtAST*> statements;
+
+    if (!lexer) {
+        // Statements are parsed one by one even on a single thread, so the result never depends on the source size
+        // or the core count
+        size_t worker_count = 1;
+        if (stream_end - stream_idx >= parallel_parse_threshold) {
+            worker_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        return parse_parallel(find_statement_boundaries(), worker_count);
+    }
+
+    while (current_token().type != TokenType::EOF) {
+        StmtAST* statement = parse_statement();
+        if (statement) {
+            statements.push_back(statement);
+        }
+    }
+
+    return statements;
 }
 
-std::vector<std::shared_ptr<StmtAST>> Parser::parse() {
-    std::vector<std::shared_ptr<StmtAST>> statements;
+void Parser::parse_range(size_t first, size_t last, std::vector<StmtAST*>& statements) {
+    stream_idx = first;
+    stream_end = last;
+    tokens_pulled = 0;
+    tokens_idx = 0;
+    orphan_braces = 0;
 
     while (current_token().type != TokenType::EOF) {
-        std::shared_ptr<StmtAST> statement = parse_statement();
+        StmtAST* statement = parse_statement();
         if (statement) {
             statements.push_back(statement);
         }
     }
+}
+
+std::vector<size_t> Parser::find_statement_boundaries() const {
+    // Only braces matter, a cheap scan over the token types
+    std::vector<size_t> boundaries{stream_idx};
+    size_t depth = 0;
+
+    for (size_t i = stream_idx; i < stream_end; i++) {
+        switch (stream->type(i)) {
+            case TokenType::OPEN_BRACES:
+                depth++;
+                break;
+            case TokenType::CLOSE_BRACES:
+                // A stray '}' ends the statement it is in, like a matching one would
+                if (depth > 0) {
+                    depth--;
+                }
+                if (depth == 0) {
+                    boundaries.push_back(i + 1);
+                }
+                break;
+            case TokenType::SEMICOLON:
+                if (depth == 0) {
+                    boundaries.push_back(i + 1);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    // An unclosed brace runs to the end, as it would when parsing serially
+    if (boundaries.back() != stream_end) {
+        boundaries.push_back(stream_end);
+    }
+    return boundaries;
+}
+
+std::vector<StmtAST*> Parser::parse_parallel(const std::vector<size_t>& boundaries, size_t worker_count) {
+    // Every statement is parsed on its own, error recovery included, so how the statements are dealt out to the
+    // workers never changes the result. Each worker gets a contiguous run of statements holding about the same
+    // number of tokens, which keeps merging them back in source order trivial
+    size_t statement_count = boundaries.size() - 1;
+    size_t token_count = boundaries.back() - boundaries.front();
+
+    std::vector<size_t> runs{0};
+    for (size_t i = 1; i < statement_count && runs.size() < worker_count; i++) {
+        if (boundaries[i] - boundaries.front() >= token_count * runs.size() / worker_count) {
+            runs.push_back(i);
+        }
+    }
+    runs.push_back(statement_count);
+
+    // The first run is parsed by this parser on the calling thread, straight into its own arena
+    size_t run_count = runs.size() - 1;
+    std::vector<std::unique_ptr<AstArena>> run_arenas(run_count);
+    std::vector<std::unique_ptr<Parser>> run_parsers(run_count);
+    std::vector<std::vector<StmtAST*>> run_statements(run_count);
+    for (size_t i = 1; i < run_count; i++) {
+        run_arenas[i] = std::make_unique<AstArena>();
+        run_parsers[i] = std::unique_ptr<Parser>{new Parser{stream, source_map, ctx, *run_arenas[i]}};
+    }
+
+    auto parse_run = [&](Parser& parser, size_t i) {
+        for (size_t statement = runs[i]; statement < runs[i + 1]; statement++) {
+            parser.parse_range(boundaries[statement], boundaries[statement + 1], run_statements[i]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < run_count; i++) {
+        workers.emplace_back(parse_run, std::ref(*run_parsers[i]), i);
+    }
+    parse_run(*this, 0);
+
+    std::vector<StmtAST*> statements = std::move(run_statements[0]);
+    for (size_t i = 1; i < run_count; i++) {
+        workers[i - 1].join();
+
+        statements.insert(statements.end(), run_statements[i].begin(), run_statements[i].end());
+        for (auto& exception: run_parsers[i]->exceptions) {
+            exceptions.push_back(exception);
+        }
+        arena.adopt(std::move(*run_arenas[i]));
+    }
 
+    // Leaves the parser at the end of the stream
+    stream_idx = stream_end = boundaries.back();
+    tokens_pulled = 0;
+    tokens_idx = 0;
     return statements;
 }
\ No newline at end of file
@@ -0,0 +1,35 @@
+#include <algorithm>
+#include <cstring>
+
+#include "chung/source_map.hpp"
+
+SourceMap::SourceMap(std::string_view source): source{source}, line_offsets{0} {
+    // memchr is vectorized by libc, which makes this scan a lot faster than a byte loop
+    const char* beg = source.data();
+    const char* end = beg + source.size();
+    const char* newline = beg;
+
+    while ((newline = static_cast<const char*>(std::memchr(newline, '\n', end - newline)))) {
+        newline++;
+        line_offsets.push_back(static_cast<uint32_t>(newline - beg));
+    }
+}
+
+uint32_t SourceMap::line(uint32_t offset) const {
+    auto line_start = std::upper_bound(line_offsets.begin(), line_offsets.end(), offset);
+    return static_cast<uint32_t>(line_start - line_offsets.begin());
+}
+
+uint32_t SourceMap::column(uint32_t offset) const {
+    return offset - line_offsets[line(offset) - 1];
+}
+
+std::string_view SourceMap::line_text(uint32_t line) const {
+    if (line == 0 || line > line_offsets.size()) {
+        return {};
+    }
+
+    size_t beg = line_offsets[line - 1];
+    size_t end = line < line_offsets.size() ? line_offsets[line] - 1 : source.size();
+    return source.substr(beg, end - beg);
+}
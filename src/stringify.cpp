@@ -9,29 +9,33 @@ inline std::string indent(size_t indent_level) {
     return indentation;
 }
 
-std::string stringify_op(const TokenType& op, bool verbose) {
+const char* stringify_op(const TokenType& op, bool verbose) {
     static const char* op_names[] = {
         "Add", "Subtract", "Multiply", "Divide", "Modulo", "Power",
         "BitwiseAnd", "BitwiseOr", "BitwiseNot",
+        "Equal", "NotEqual", "Less", "LessEqual", "Greater", "GreaterEqual",
 
         "Assign"
     };
     static const char *ops[] = {
         "+", "-", "*", "/", "%", "**",
         "&", "|", "~",
+        "==", "!=", "<", "<=", ">", ">=",
         "="
     };
 
+    size_t idx = static_cast<size_t>(op) - static_cast<size_t>(TokenType::ADD);
     if (verbose) {
-        return op_names[static_cast<int>(op) - 3];
+        return op_names[idx];
     }
-    return ops[static_cast<int>(op) - 3];
+    return ops[idx];
 }
 
-std::string stringify_symbol(const TokenType& symbol, bool verbose) {
+const char* stringify_symbol(const TokenType& symbol, bool verbose) {
     static const char* symbol_names[] = {
         "OpenParentheses", "CloseParentheses", "OpenBrackets", "CloseBrackets",
         "OpenBraces", "CloseBraces",
+        "Arrow",
         "Dot", "Comma", "Colon", "Semicolon"
     };
     static const char* symbols[] = {
@@ -40,20 +44,21 @@ std::string stringify_symbol(const TokenType& symbol, bool verbose) {
         ".", ",", ":", ";"
     };
 
+    size_t idx = static_cast<size_t>(symbol) - static_cast<size_t>(TokenType::OPEN_PARENTHESES);
     if (verbose) {
-        return symbol_names[static_cast<int>(symbol) - 13];
+        return symbol_names[idx];
     }
-    return std::string{symbols[static_cast<int>(symbol) - 13]};
+    return symbols[idx];
 }
 
-std::string stringify_keyword(const TokenType& keyword) {
+const char* stringify_keyword(const TokenType& keyword) {
     static const char* keyword_names[] = {
         "Def", "Let", "__OMG"
     };
-    return keyword_names[static_cast<int>(keyword) - 24];
+    return keyword_names[static_cast<size_t>(keyword) - static_cast<size_t>(TokenType::DEF)];
 }
 
-std::string stringify_type(const TokenType& type) {
+const char* stringify_type(const TokenType& type) {
     if (type == TokenType::EOF) {
         return "EndOfFile";
     } else if (type == TokenType::INVALID) {
@@ -77,7 +82,7 @@ std::string stringify_type(const TokenType& type) {
     }
 }
 
-std::string stringify(const Token& token) {
+std::string_view token_name(const Token& token) {
     if (token.type == TokenType::EOF) {
         return "EOF";
     } else if (token.type == TokenType::INVALID) {
@@ -97,6 +102,10 @@ std::string stringify(const Token& token) {
     }
 }
 
+std::string stringify(const Token& token) {
+    return std::string{token_name(token)};
+}
+
 std::string AST::stringify(size_t indent_level) {
     // OOF
     return indent(indent_level) + "Goofy ASF AST";
@@ -114,11 +123,11 @@ std::string FunctionAST::stringify(size_t indent_level) {
     std::string indentation = indent(indent_level);
     std::string string{indentation + "Function Declaration:"};
 
-    string += "\n\t" + indentation + "Name: " + name;
+    string += "\n\t" + indentation + "Name: " + std::string{Interner::global().text(name)};
     string += "\n\t" + indentation + "Parameters:";
 
     for (size_t i = 0; i < parameters.size(); i++) {
-        string += "\n\t\t" + indentation + "Parameter " + std::to_string(i) + ": " + parameters[i].name;
+        string += "\n\t\t" + indentation + "Parameter " + std::to_string(i) + ": " + std::string{Interner::global().text(parameters[i]->name)};
     }
     if (parameters.size() == 0) {
         string += "\n\t\tNo Parameters";
@@ -131,7 +140,7 @@ std::string VarDeclareAST::stringify(size_t indent_level) {
     std::string indentation = indent(indent_level);
     std::string string{indentation + "Variable Declaration:"};
 
-    string += "\n\t" + indentation + "Name: " + name;
+    string += "\n\t" + indentation + "Name: " + std::string{Interner::global().text(name)};
     string += "\n\t" + indentation + "Value:\n" + expr->stringify(indent_level + 2);
     
     return string;
@@ -158,7 +167,7 @@ std::string BinaryExprAST::stringify(size_t indent_level) {
     std::string indentation = indent(indent_level);
     std::string string{indentation + "Binary Operation:"};
 
-    string += "\n\t" + indentation + "Operator: " + stringify_type(op);
+    string += "\n\t" + indentation + "Operator: " + stringify_op(op, true);
 
     // 2 new indentation level: 1 for "Binary Operation" and another for the side
     string += "\n\t" + indentation + "Left Hand:\n" + lhs->stringify(indent_level + 2);
@@ -167,11 +176,21 @@ std::string BinaryExprAST::stringify(size_t indent_level) {
     return string;
 }
 
+std::string UnaryExprAST::stringify(size_t indent_level) {
+    std::string indentation = indent(indent_level);
+    std::string string{indentation + "Unary Operation:"};
+
+    string += "\n\t" + indentation + "Operator: " + stringify_op(op, true);
+    string += "\n\t" + indentation + "Operand:\n" + operand->stringify(indent_level + 2);
+
+    return string;
+}
+
 std::string CallAST::stringify(size_t indent_level) {
     std::string indentation = indent(indent_level);
     std::string string{indentation + "Call:"};
 
-    string += "\n\t" + indentation + "Name: " + callee;
+    string += "\n\t" + indentation + "Name: " + std::string{Interner::global().text(callee)};
     string += "\n\t" + indentation + "Arguments:\n";
     
     for (size_t i = 0; i < arguments.size(); i++) {
@@ -198,7 +217,7 @@ std::string PrimitiveAST::stringify(size_t indent_level) {
         case ValueType::FLOAT64:
             return indentation + "Float64: " + std::to_string(float64) + '\n';
         case ValueType::STRING:
-            return indentation + "String: \"" + string + "\"\n";
+            return indentation + "String: \"" + std::string{string} + "\"\n";
         default:
             return indentation + "Invalid\n";
     }
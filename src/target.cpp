@@ -0,0 +1,122 @@
+#include "llvm/ADT/StringMap.h"
+#include "llvm/TargetParser/Host.h"
+
+#include "chung/target.hpp"
+
+bool parse_target_option(const std::string& flag, TargetSettings& settings) {
+    std::string_view option{flag};
+
+    auto value_of = [&](std::string_view prefix, std::string_view& value) {
+        if (option.substr(0, prefix.size()) != prefix || option.size() == prefix.size()) {
+            return false;
+        }
+        value = option.substr(prefix.size());
+        return true;
+    };
+
+    std::string_view value;
+    if (value_of("-march=", value) || value_of("-mcpu=", value)) {
+        settings.cpu = value;
+    } else if (value_of("-mattr=", value)) {
+        if (!settings.features.empty()) {
+            settings.features += ',';
+        }
+        settings.features += value;
+    } else if (option == "-ffast-math") {
+        settings.fast_math.setFast();
+        settings.fp_contract = llvm::FPOpFusion::Fast;
+    } else if (option == "-fno-honor-nans") {
+        settings.fast_math.setNoNaNs();
+    } else if (option == "-fno-honor-infinities") {
+        settings.fast_math.setNoInfs();
+    } else if (option == "-fno-signed-zeros") {
+        settings.fast_math.setNoSignedZeros();
+    } else if (value_of("-ffp-contract=", value)) {
+        if (value == "fast") {
+            settings.fp_contract = llvm::FPOpFusion::Fast;
+        } else if (value == "on") {
+            settings.fp_contract = llvm::FPOpFusion::Standard;
+        } else if (value == "off") {
+            settings.fp_contract = llvm::FPOpFusion::Strict;
+        } else {
+            return false;
+        }
+        settings.fast_math.setAllowContract(value == "fast");
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void resolve_native_cpu(TargetSettings& settings) {
+    if (settings.cpu != "native") {
+        return;
+    }
+
+    settings.cpu = llvm::sys::getHostCPUName().str();
+
+    // The CPU name alone misses features the host has or lacks, like AVX-512 on some models or AVX when the OS
+    // doesn't save its registers
+    std::string features;
+    llvm::StringMap<bool> host_features;
+    if (llvm::sys::getHostCPUFeatures(host_features)) {
+        for (const auto& feature: host_features) {
+            features += feature.second ? '+' : '-';
+            features += feature.first();
+            features += ',';
+        }
+    }
+
+    // The features given explicitly come last, and win
+    if (settings.features.empty() && !features.empty()) {
+        features.pop_back();
+    }
+    settings.features = features + settings.features;
+}
+
+llvm::TargetOptions target_options(const TargetSettings& settings) {
+    const llvm::FastMathFlags& fast_math = settings.fast_math;
+
+    llvm::TargetOptions options;
+    options.UnsafeFPMath = fast_math.allowReassoc();
+    options.NoNaNsFPMath = fast_math.noNaNs();
+    options.NoInfsFPMath = fast_math.noInfs();
+    options.NoSignedZerosFPMath = fast_math.noSignedZeros();
+    options.ApproxFuncFPMath = fast_math.approxFunc();
+    options.AllowFPOpFusion = settings.fp_contract;
+    return options;
+}
+
+void apply_target_attributes(llvm::Module& module, const llvm::TargetMachine& target_machine) {
+    llvm::StringRef cpu = target_machine.getTargetCPU();
+    llvm::StringRef features = target_machine.getTargetFeatureString();
+    const llvm::TargetOptions& options = target_machine.Options;
+
+    for (llvm::Function& function: module) {
+        if (function.isDeclaration()) {
+            continue;
+        }
+
+        function.addFnAttr("target-cpu", cpu);
+        if (!features.empty()) {
+            function.addFnAttr("target-features", features);
+        }
+
+        // The spellings clang uses, which the backend reads back
+        if (options.UnsafeFPMath) {
+            function.addFnAttr("unsafe-fp-math", "true");
+        }
+        if (options.NoNaNsFPMath) {
+            function.addFnAttr("no-nans-fp-math", "true");
+        }
+        if (options.NoInfsFPMath) {
+            function.addFnAttr("no-infs-fp-math", "true");
+        }
+        if (options.NoSignedZerosFPMath) {
+            function.addFnAttr("no-signed-zeros-fp-math", "true");
+        }
+        if (options.ApproxFuncFPMath) {
+            function.addFnAttr("approx-func-fp-math", "true");
+        }
+    }
+}
@@ -2,52 +2,47 @@
 
 #include "chung/token.hpp"
 
-bool is_keyword(const std::string& identifier) {
-    static const std::vector<std::string> keyword_identifiers{
-        "def", "let", "__omg"
-    };
-
-    if (std::find(std::begin(keyword_identifiers), std::end(keyword_identifiers), identifier) != std::end(keyword_identifiers)) {
-        return true;
+template <typename T>
+static void splice_column(std::vector<T>& column, size_t first, size_t last, const std::vector<T>& replacement) {
+    // Overwrite what overlaps, then only insert or erase the difference
+    size_t overlap = std::min(last - first, replacement.size());
+    std::copy(replacement.begin(), replacement.begin() + overlap, column.begin() + first);
+
+    if (replacement.size() > overlap) {
+        column.insert(column.begin() + first + overlap, replacement.begin() + overlap, replacement.end());
+    } else {
+        column.erase(column.begin() + first + overlap, column.begin() + last);
     }
-    return false;
 }
 
-bool is_keyword(TokenType keyword) {
-    static const std::vector<TokenType> keywords{
-        TokenType::DEF, TokenType::LET, TokenType::__OMG
-    };
+size_t TokenStream::first_ending_after(uint32_t offset) const {
+    return std::lower_bound(ends.begin(), ends.end(), offset) - ends.begin();
+}
 
-    if (std::find(std::begin(keywords), std::end(keywords), keyword) != std::end(keywords)) {
-        return true;
+size_t TokenStream::find_beg(uint32_t beg, size_t from) const {
+    auto result = std::lower_bound(begs.begin() + from, begs.end(), beg);
+    if (result == begs.end() || *result != beg) {
+        return size();
     }
-    return false;
+    return result - begs.begin();
 }
 
-bool is_symbol(TokenType symbol) {
-    static const std::vector<TokenType> symbols{
-        TokenType::OPEN_PARENTHESES, TokenType::CLOSE_PARENTHESES,
-        TokenType::OPEN_BRACKETS, TokenType::CLOSE_BRACKETS,
-        TokenType::OPEN_BRACES, TokenType::CLOSE_BRACES,
-        TokenType::ARROW,
-        TokenType::DOT, TokenType::COMMA, TokenType::COLON, TokenType::SEMICOLON
-    };
-
-    if (std::find(std::begin(symbols), std::end(symbols), symbol) != std::end(symbols)) {
-        return true;
+void TokenStream::splice(size_t first, size_t last, const TokenStream& replacement, int64_t delta) {
+    for (size_t i = last; i < size(); i++) {
+        begs[i] = static_cast<uint32_t>(begs[i] + delta);
+        ends[i] = static_cast<uint32_t>(ends[i] + delta);
     }
-    return false;
-}
 
-bool is_operator(TokenType op) {
-    static const std::vector<TokenType> ops{
-        TokenType::ADD, TokenType::SUB, TokenType::MUL, TokenType::DIV, TokenType::MOD, TokenType::POW,
-        TokenType::BITWISE_AND, TokenType::BITWISE_OR, TokenType::BITWISE_NOT,
-        TokenType::ASSIGN
-    };
+    splice_column(types, first, last, replacement.types);
+    splice_column(begs, first, last, replacement.begs);
+    splice_column(ends, first, last, replacement.ends);
+    splice_column(values, first, last, replacement.values);
+}
 
-    if (std::find(std::begin(ops), std::end(ops), op) != std::end(ops)) {
-        return true;
+void TokenStream::remap_symbols(const std::vector<Symbol>& symbols) {
+    for (size_t i = 0; i < size(); i++) {
+        if (types[i] == TokenType::IDENTIFIER) {
+            values[i].symbol = symbols[values[i].symbol];
+        }
     }
-    return false;
-}
\ No newline at end of file
+}
@@ -7,4 +7,15 @@ Type Type::tinvalid = Type{Ty::TINVALID, "invalid"};
 Type Type::tuint64 = Type{Ty::TUINT64, "uint64"};
 Type Type::tint64 = Type{Ty::TINT64, "int64"};
 Type Type::tfloat64 = Type{Ty::TFLOAT64, "float64"};
-Type Type::tstring = Type{Ty::TSTRING, "string"};
\ No newline at end of file
+Type Type::tstring = Type{Ty::TSTRING, "string"};
+
+Type& Type::from_ty(Ty ty) {
+    switch (ty) {
+        case Ty::TNONE: return tnone;
+        case Ty::TUINT64: return tuint64;
+        case Ty::TINT64: return tint64;
+        case Ty::TFLOAT64: return tfloat64;
+        case Ty::TSTRING: return tstring;
+        default: return tinvalid;
+    }
+}
\ No newline at end of file